@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "copy.h"
+
+#ifdef _TMS320C6400_PLUS
+#include <c6x.h>
+#endif
+
+#define ALIGNED(p, n) (((size_t) (p) & ((n) - 1)) == 0)
+
+/* otherwise gcc turns the reference into a memcpy() call */
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__TI_COMPILER_VERSION__)
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+#endif
+void
+copy_ref(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *restrict d = dst;
+	const unsigned char *restrict s = src;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		d[i] = s[i];
+}
+
+void
+copy_words(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *d8 = dst;
+	const unsigned char *s8 = src;
+	unsigned int *restrict d;
+	const unsigned int *restrict s;
+	size_t i, n;
+
+	if (((size_t) d8 & 3) != ((size_t) s8 & 3)) {
+		copy_ref(dst, src, size);
+		return;
+	}
+
+	/* head, until both are aligned */
+	while (size && !ALIGNED(d8, 4)) {
+		*d8++ = *s8++;
+		size--;
+	}
+
+	d = (unsigned int *) d8;
+	s = (const unsigned int *) s8;
+	n = size / 16;
+
+	for (i = 0; i < n; i++) {
+		unsigned int a = s[0], b = s[1], c = s[2], e = s[3];
+
+		d[0] = a;
+		d[1] = b;
+		d[2] = c;
+		d[3] = e;
+		d += 4;
+		s += 4;
+	}
+
+	for (n = size & 15; n >= 4; n -= 4)
+		*d++ = *s++;
+
+	copy_ref(d, s, n);
+}
+
+#ifdef _TMS320C6400_PLUS
+void
+copy_c64x(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i, n;
+
+	/* word-by-word is as good for short copies */
+	if (size < 64) {
+		copy_words(dst, src, size);
+		return;
+	}
+
+	/* the destination gets aligned; the source may stay unaligned */
+	while (!ALIGNED(d, 8)) {
+		*d++ = *s++;
+		size--;
+	}
+
+	n = size / 16;
+
+	if (ALIGNED(s, 8)) {
+		#pragma MUST_ITERATE(2,,)
+		for (i = 0; i < n; i++) {
+			_amem8(d) = _amem8((void *) s);
+			_amem8(d + 8) = _amem8((void *) (s + 8));
+			d += 16;
+			s += 16;
+		}
+	} else {
+		#pragma MUST_ITERATE(2,,)
+		for (i = 0; i < n; i++) {
+			_amem8(d) = _mem8((void *) s);
+			_amem8(d + 8) = _mem8((void *) (s + 8));
+			d += 16;
+			s += 16;
+		}
+	}
+
+	copy_words(d, s, size & 15);
+}
+#endif
+
+const struct copy_kernel copy_kernels[] = {
+	{ "ref", copy_ref },
+	{ "words", copy_words },
+#ifdef _TMS320C6400_PLUS
+	{ "c64x", copy_c64x },
+#endif
+	{ NULL, NULL },
+};
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef COPY_H
+#define COPY_H
+
+#include <stddef.h>
+
+/*
+ * Data movement kernels; plain C99 so the same source builds for the DSP
+ * node and for the host. The buffers must not overlap.
+ */
+
+/* byte at a time; the reference the others are checked against */
+void copy_ref(void *dst,
+		const void *src,
+		size_t size);
+
+/* 32-bit words, unrolled; falls back to bytes when the alignment differs */
+void copy_words(void *dst,
+		const void *src,
+		size_t size);
+
+#ifdef _TMS320C6400_PLUS
+/* 64-bit loads and stores with _amem8/_mem8 */
+void copy_c64x(void *dst,
+		const void *src,
+		size_t size);
+
+#define copy_data copy_c64x
+#else
+#define copy_data copy_words
+#endif
+
+struct copy_kernel {
+	const char *name;
+	void (*copy)(void *dst, const void *src, size_t size);
+};
+
+/* terminated by an entry with no name */
+extern const struct copy_kernel copy_kernels[];
+
+#endif /* COPY_H */
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "copy.h"
+#include "log.h"
+
+/*
+ * Throughput of the copy kernels on their own, without the bridge; libc's
+ * memcpy() is there as the baseline.
+ */
+
+static size_t sizes[] = { 64, 256, 0x1000, 0x10000, 0x100000 };
+static size_t size;
+static unsigned int misalign;
+static unsigned long min_bytes = 256 * 0x100000;
+static bool json;
+
+static void
+copy_libc(void *dst,
+		const void *src,
+		size_t size)
+{
+	memcpy(dst, src, size);
+}
+
+static inline uint64_t
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool
+check(const struct copy_kernel *k,
+		unsigned char *dst,
+		unsigned char *src,
+		size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		src[i] = i * 7 + 1;
+	memset(dst, 0, size + 16);
+	k->copy(dst, src, size);
+
+	if (memcmp(dst, src, size)) {
+		pr_err("%s: wrong data at size %zu", k->name, size);
+		return false;
+	}
+	for (i = size; i < size + 16; i++) {
+		if (dst[i]) {
+			pr_err("%s: overrun at size %zu", k->name, size);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static double
+measure(const struct copy_kernel *k,
+		unsigned char *dst,
+		unsigned char *src,
+		size_t size)
+{
+	unsigned long i, times;
+	uint64_t start, elapsed;
+
+	times = min_bytes / size;
+	if (times == 0)
+		times = 1;
+
+	/* warm up the caches */
+	k->copy(dst, src, size);
+
+	start = now();
+	for (i = 0; i < times; i++)
+		k->copy(dst, src, size);
+	elapsed = now() - start;
+
+	return elapsed ? (double) size * times / elapsed * 1000.0 : 0.0;
+}
+
+static bool
+run(const struct copy_kernel *k,
+		size_t size,
+		bool *first)
+{
+	unsigned char *src, *dst;
+	double mbps;
+
+	/* room for the misalignment and the overrun check */
+	src = malloc(size + 64);
+	dst = malloc(size + 64);
+	if (!src || !dst) {
+		pr_err("failed to allocate %zu bytes", size);
+		free(src);
+		free(dst);
+		return false;
+	}
+
+	if (!check(k, dst + misalign, src, size) ||
+			!check(k, dst, src + misalign, size)) {
+		free(src);
+		free(dst);
+		return false;
+	}
+
+	mbps = measure(k, dst + misalign, src, size);
+
+	if (json)
+		printf("%s{ \"kernel\": \"%s\", \"size\": %zu, \"misalign\": %u, \"mb_s\": %.1f }",
+				*first ? "" : ", ", k->name, size, misalign, mbps);
+	else
+		printf("%-8s %10zu %10.1f MB/s\n", k->name, size, mbps);
+	*first = false;
+
+	free(src);
+	free(dst);
+
+	return true;
+}
+
+static void handle_options(int *argc, const char ***argv)
+{
+	while (*argc > 0) {
+		const char *cmd = (*argv)[0];
+		if (cmd[0] != '-')
+			break;
+
+		if (!strcmp(cmd, "--json"))
+			json = true;
+
+		if (!strcmp(cmd, "-s") || !strcmp(cmd, "--size")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			size = strtoul((*argv)[1], NULL, 0);
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "-m") || !strcmp(cmd, "--misalign")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			misalign = atoi((*argv)[1]) & 15;
+			(*argv)++;
+			(*argc)--;
+		}
+
+		(*argv)++;
+		(*argc)--;
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	const struct copy_kernel libc = { "memcpy", copy_libc };
+	const struct copy_kernel *k;
+	unsigned int i, nr_sizes = sizeof(sizes) / sizeof(*sizes);
+	bool first = true;
+	int ret = 0;
+
+	argc--; argv++;
+	handle_options(&argc, &argv);
+
+	if (size) {
+		sizes[0] = size;
+		nr_sizes = 1;
+	}
+
+	if (json)
+		printf("[ ");
+	else
+		printf("%-8s %10s %15s\n", "kernel", "size", "throughput");
+
+	for (i = 0; i < nr_sizes; i++) {
+		for (k = copy_kernels; k->name; k++) {
+			if (!run(k, sizes[i], &first))
+				ret = -1;
+		}
+		if (!run(&libc, sizes[i], &first))
+			ret = -1;
+	}
+
+	if (json)
+		printf(" ]\n");
+
+	return ret;
+}
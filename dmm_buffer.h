@@ -16,12 +16,19 @@
 
 #include <stdlib.h> /* for calloc, free */
 #include <string.h> /* for memset */
+#include <stdio.h> /* for fopen */
+#include <sys/mman.h> /* for mmap */
 
 #include "dsp_bridge.h"
+#include "dsp_sm.h"
 #include "log.h"
 
 #define ROUND_UP(num, scale) (((num) + ((scale) - 1)) & ~((scale) - 1))
 #define PAGE_SIZE 0x1000
+/* the DSP MMU can also map 64K large pages and 1M sections */
+#define DMM_LARGE_PAGE_SIZE 0x10000
+#define DMM_SECTION_SIZE 0x100000
+#define DMM_MAX_RANGES 8
 
 enum dma_data_direction {
 	DMA_BIDIRECTIONAL,
@@ -29,7 +36,224 @@ enum dma_data_direction {
 	DMA_FROM_DEVICE,
 };
 
-typedef struct {
+/*
+ * Cache of DSP mappings for memory handed in with dmm_buffer_use(); the
+ * same (address, size, direction) gets the same DSP address back without
+ * any ioctl. The least recently used mappings that are not in use get
+ * evicted when the budget (0 for none) or the DSP virtual space runs out.
+ *
+ * Memory must be dropped from the cache with dmm_map_cache_drop() before
+ * it's given back to the system.
+ */
+
+struct dmm_map_entry {
+	struct dmm_map_entry *prev;
+	struct dmm_map_entry *next;
+	void *data;
+	size_t size;
+	int dir;
+	void *reserve;
+	void *map;
+	unsigned int users;
+};
+
+struct dmm_map_cache {
+	int handle;
+	void *proc;
+	struct dmm_map_entry *head;
+	struct dmm_map_entry *tail;
+	size_t mapped;
+	size_t budget;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+
+static inline struct dmm_map_cache *
+dmm_map_cache_new(int handle,
+		void *proc,
+		size_t budget)
+{
+	struct dmm_map_cache *cache;
+	cache = calloc(1, sizeof(*cache));
+
+	pr_debug("%p", cache);
+	cache->handle = handle;
+	cache->proc = proc;
+	cache->budget = budget;
+
+	return cache;
+}
+
+static inline void
+dmm_map_cache_unlink(struct dmm_map_cache *cache,
+		struct dmm_map_entry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		cache->head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		cache->tail = e->prev;
+	e->prev = e->next = NULL;
+}
+
+static inline void
+dmm_map_cache_link(struct dmm_map_cache *cache,
+		struct dmm_map_entry *e)
+{
+	e->prev = NULL;
+	e->next = cache->head;
+	if (cache->head)
+		cache->head->prev = e;
+	else
+		cache->tail = e;
+	cache->head = e;
+}
+
+static inline void
+dmm_map_cache_remove(struct dmm_map_cache *cache,
+		struct dmm_map_entry *e)
+{
+	pr_debug("%p: %p", cache, e->data);
+	dmm_map_cache_unlink(cache, e);
+	dsp_unmap(cache->handle, cache->proc, e->map);
+	dsp_unreserve(cache->handle, cache->proc, e->reserve);
+	cache->mapped -= e->size;
+	free(e);
+}
+
+/* evict the least recently used mapping that is not in use */
+static inline bool
+dmm_map_cache_evict(struct dmm_map_cache *cache)
+{
+	struct dmm_map_entry *e;
+
+	for (e = cache->tail; e; e = e->prev) {
+		if (e->users)
+			continue;
+		dmm_map_cache_remove(cache, e);
+		cache->evictions++;
+		return true;
+	}
+
+	return false;
+}
+
+static inline struct dmm_map_entry *
+dmm_map_cache_get(struct dmm_map_cache *cache,
+		void *data,
+		size_t size,
+		int dir)
+{
+	struct dmm_map_entry *e;
+	size_t to_reserve;
+
+	for (e = cache->head; e; e = e->next) {
+		if (e->data == data && e->size == size && e->dir == dir) {
+			cache->hits++;
+			if (e != cache->head) {
+				dmm_map_cache_unlink(cache, e);
+				dmm_map_cache_link(cache, e);
+			}
+			e->users++;
+			return e;
+		}
+	}
+
+	cache->misses++;
+
+	if (cache->budget) {
+		while (cache->mapped + size > cache->budget)
+			if (!dmm_map_cache_evict(cache))
+				break;
+	}
+
+	e = calloc(1, sizeof(*e));
+	e->data = data;
+	e->size = size;
+	e->dir = dir;
+
+	to_reserve = ROUND_UP(size, PAGE_SIZE) + PAGE_SIZE;
+	while (!dsp_reserve(cache->handle, cache->proc, to_reserve, &e->reserve)) {
+		if (!dmm_map_cache_evict(cache))
+			goto fail;
+	}
+	if (!dsp_map(cache->handle, cache->proc, data, size, e->reserve, &e->map, 0)) {
+		dsp_unreserve(cache->handle, cache->proc, e->reserve);
+		goto fail;
+	}
+
+	cache->mapped += size;
+	e->users = 1;
+	dmm_map_cache_link(cache, e);
+
+	return e;
+
+fail:
+	pr_err("%p: failed to map %p", cache, data);
+	free(e);
+	return NULL;
+}
+
+static inline void
+dmm_map_cache_put(struct dmm_map_cache *cache,
+		struct dmm_map_entry *e)
+{
+	e->users--;
+}
+
+/* forget every mapping that overlaps the memory */
+static inline void
+dmm_map_cache_drop(struct dmm_map_cache *cache,
+		void *data,
+		size_t size)
+{
+	struct dmm_map_entry *e, *next;
+	char *start = data;
+
+	for (e = cache->head; e; e = next) {
+		char *e_start = e->data;
+		next = e->next;
+		if (e_start < start + size && start < e_start + e->size) {
+			if (e->users)
+				pr_warning("%p: dropping %p while in use", cache, e->data);
+			dmm_map_cache_remove(cache, e);
+		}
+	}
+}
+
+static inline void
+dmm_map_cache_free(struct dmm_map_cache *cache)
+{
+	pr_debug("%p", cache);
+	if (!cache)
+		return;
+	while (cache->head)
+		dmm_map_cache_remove(cache, cache->head);
+	free(cache);
+}
+
+/*
+ * Who owns the buffer's cache lines; flushes and invalidates are only
+ * issued when the state requires them. CPU writes must be declared with
+ * dmm_buffer_dirty(), otherwise a clean buffer is not flushed again.
+ */
+enum dmm_state {
+	DMM_CPU_DIRTY, /* the CPU may have written it */
+	DMM_CPU_CLEAN, /* memory is up to date with the CPU's view */
+	DMM_DEVICE_OWNED, /* between begin and end */
+	DMM_DEVICE_WRITTEN, /* the device wrote it, and the cache was invalidated */
+};
+
+struct dmm_range {
+	size_t offset;
+	size_t len;
+};
+
+typedef struct dmm_buffer {
 	int handle;
 	void *proc;
 	void *data;
@@ -44,8 +268,30 @@ typedef struct {
 	bool used;
 	bool keyframe;
 	int dir;
+	struct dmm_buffer *next;
+	struct dmm_map_cache *cache;
+	struct dmm_map_entry *entry;
+	struct dmm_range dirty[DMM_MAX_RANGES];
+	unsigned int nr_dirty;
+	/* the ranges don't say it all; marking one can't narrow the flush */
+	bool all_dirty;
+	enum dmm_state state;
+	unsigned long skipped;
+	unsigned long maintained; /* bytes flushed or invalidated */
+	struct dsp_sm *sm;
+	size_t page_size;
+	size_t allocated_size;
 } dmm_buffer_t;
 
+/* nothing is known about what the CPU wrote; the next flush covers it all */
+static inline void
+dmm_buffer_dirty_all(dmm_buffer_t *b)
+{
+	b->state = DMM_CPU_DIRTY;
+	b->all_dirty = true;
+	b->nr_dirty = 0;
+}
+
 static inline dmm_buffer_t *
 dmm_buffer_new(int handle,
 		void *proc,
@@ -59,42 +305,314 @@ dmm_buffer_new(int handle,
 	b->proc = proc;
 	b->alignment = 128;
 	b->dir = dir;
+	dmm_buffer_dirty_all(b);
 
 	return b;
 }
 
+/* allocated_size is only set when the data was mmap'ed */
+static inline void
+dmm_buffer_free_data(dmm_buffer_t *b)
+{
+	if (b->allocated_size)
+		munmap(b->allocated_data, b->allocated_size);
+	else
+		free(b->allocated_data);
+	b->allocated_data = NULL;
+	b->allocated_size = 0;
+}
+
 static inline void
 dmm_buffer_free(dmm_buffer_t *b)
 {
 	pr_debug("%p", b);
 	if (!b)
 		return;
-	if (b->map)
+	if (b->sm)
+		dsp_sm_release(b->sm, b->data);
+	else if (b->entry)
+		dmm_map_cache_put(b->cache, b->entry);
+	else if (b->map)
 		dsp_unmap(b->handle, b->proc, b->map);
 	if (b->reserve)
 		dsp_unreserve(b->handle, b->proc, b->reserve);
-	free(b->allocated_data);
+	dmm_buffer_free_data(b);
 	free(b);
 }
 
+/*
+ * Mark a range written by the CPU; dmm_buffer_begin() then flushes only
+ * the marked ranges, merged and aligned to cache lines, instead of the
+ * whole length. A buffer that was just allocated, used or acquired from a
+ * pool is flushed whole regardless.
+ */
+static inline void
+dmm_buffer_dirty(dmm_buffer_t *b,
+		size_t offset,
+		size_t len)
+{
+	unsigned long addr = (unsigned long) b->data;
+	size_t start, end;
+	unsigned int i, j;
+
+	if (!len)
+		return;
+
+	/* the device's write would clobber it; keep the invalidate end() owes */
+	if (b->state == DMM_DEVICE_OWNED) {
+		pr_err("%p written while the device owns it", b);
+		return;
+	}
+
+	if (b->state != DMM_CPU_DIRTY) {
+		b->state = DMM_CPU_DIRTY;
+		b->all_dirty = false;
+		b->nr_dirty = 0;
+	}
+	if (b->all_dirty)
+		return;
+
+	start = ((addr + offset) & ~(CACHE_LINE_SIZE - 1UL)) - addr;
+	end = ROUND_UP(addr + offset + len, CACHE_LINE_SIZE) - addr;
+	if (start > offset)
+		start = 0;
+	if (end > b->size)
+		end = b->size;
+
+	/* find the first range that ends at or after the start */
+	for (i = 0; i < b->nr_dirty; i++)
+		if (b->dirty[i].offset + b->dirty[i].len >= start)
+			break;
+
+	/* absorb all the ranges it touches */
+	for (j = i; j < b->nr_dirty && b->dirty[j].offset <= end; j++) {
+		if (b->dirty[j].offset < start)
+			start = b->dirty[j].offset;
+		if (b->dirty[j].offset + b->dirty[j].len > end)
+			end = b->dirty[j].offset + b->dirty[j].len;
+	}
+
+	if (i == j && b->nr_dirty == DMM_MAX_RANGES) {
+		/* no room; grow the closest range instead */
+		if (i == b->nr_dirty || (i > 0 &&
+					start - (b->dirty[i - 1].offset + b->dirty[i - 1].len) <
+					b->dirty[i].offset - end))
+			i--;
+		if (b->dirty[i].offset < start)
+			start = b->dirty[i].offset;
+		if (b->dirty[i].offset + b->dirty[i].len > end)
+			end = b->dirty[i].offset + b->dirty[i].len;
+		j = i + 1;
+	}
+
+	memmove(&b->dirty[i + 1], &b->dirty[j], (b->nr_dirty - j) * sizeof(*b->dirty));
+	b->nr_dirty -= j - i - 1;
+	b->dirty[i].offset = start;
+	b->dirty[i].len = end - start;
+}
+
+/* the _v variants issue one ioctl per this many buffers */
+#define DMM_CHUNK 32
+
+/* all the buffers must belong to the same handle and processor */
+static inline void
+dmm_buffer_begin_v(dmm_buffer_t **bufs,
+		const size_t *lens,
+		unsigned int count)
+{
+	struct dsp_range flush[DMM_CHUNK * DMM_MAX_RANGES];
+	struct dsp_range inv[DMM_CHUNK];
+	unsigned int i, j, n, nr_flush, nr_inv;
+
+	for (n = 0; n < count; n += DMM_CHUNK) {
+		nr_flush = nr_inv = 0;
+
+		for (i = n; i < count && i < n + DMM_CHUNK; i++) {
+			dmm_buffer_t *b = bufs[i];
+			size_t len = lens ? lens[i] : b->size;
+
+			pr_debug("%p", b);
+			if (b->sm || b->state != DMM_CPU_DIRTY) {
+				/* nothing in the cache the device could miss or clobber */
+				b->skipped++;
+				b->state = DMM_DEVICE_OWNED;
+				continue;
+			}
+
+			b->state = DMM_DEVICE_OWNED;
+
+			if (b->dir == DMA_FROM_DEVICE) {
+				inv[nr_inv].mpu_addr = b->data;
+				inv[nr_inv].size = len;
+				nr_inv++;
+				b->maintained += len;
+			} else if (b->all_dirty || !b->nr_dirty) {
+				flush[nr_flush].mpu_addr = b->data;
+				flush[nr_flush].size = len;
+				nr_flush++;
+				b->maintained += len;
+			} else {
+				for (j = 0; j < b->nr_dirty; j++) {
+					flush[nr_flush].mpu_addr = (char *) b->data + b->dirty[j].offset;
+					flush[nr_flush].size = b->dirty[j].len;
+					nr_flush++;
+					b->maintained += b->dirty[j].len;
+				}
+			}
+			b->nr_dirty = 0;
+			b->all_dirty = false;
+		}
+
+		if (nr_flush)
+			dsp_flush_v(bufs[0]->handle, bufs[0]->proc, flush, nr_flush, 1);
+		if (nr_inv)
+			dsp_invalidate_v(bufs[0]->handle, bufs[0]->proc, inv, nr_inv);
+	}
+}
+
 static inline void
 dmm_buffer_begin(dmm_buffer_t *b,
 		size_t len)
 {
-	pr_debug("%p", b);
-	if (b->dir == DMA_FROM_DEVICE)
-		dsp_invalidate(b->handle, b->proc, b->data, len);
-	else
-		dsp_flush(b->handle, b->proc, b->data, len, 1);
+	dmm_buffer_begin_v(&b, &len, 1);
+}
+
+/* lens are the number of bytes the DSP has written */
+static inline void
+dmm_buffer_end_v(dmm_buffer_t **bufs,
+		const size_t *lens,
+		unsigned int count)
+{
+	struct dsp_range inv[DMM_CHUNK];
+	unsigned int i, n, nr_inv;
+
+	for (n = 0; n < count; n += DMM_CHUNK) {
+		nr_inv = 0;
+
+		for (i = n; i < count && i < n + DMM_CHUNK; i++) {
+			dmm_buffer_t *b = bufs[i];
+			size_t len = lens ? lens[i] : b->size;
+
+			pr_debug("%p", b);
+			if (b->sm) {
+				b->skipped++;
+				b->state = DMM_CPU_CLEAN;
+				continue;
+			}
+			if (b->state != DMM_DEVICE_OWNED) {
+				b->skipped++;
+				continue;
+			}
+
+			if (b->dir == DMA_TO_DEVICE) {
+				b->state = DMM_CPU_CLEAN;
+				continue;
+			}
+
+			/* drop whatever was speculatively loaded while the device wrote */
+			if (len) {
+				inv[nr_inv].mpu_addr = b->data;
+				inv[nr_inv].size = len;
+				nr_inv++;
+				b->maintained += len;
+			} else
+				b->skipped++;
+			b->state = DMM_DEVICE_WRITTEN;
+		}
+
+		if (nr_inv)
+			dsp_invalidate_v(bufs[0]->handle, bufs[0]->proc, inv, nr_inv);
+	}
 }
 
 static inline void
 dmm_buffer_end(dmm_buffer_t *b,
 		size_t len)
 {
-	pr_debug("%p", b);
-	if (b->dir != DMA_TO_DEVICE)
-		dsp_invalidate(b->handle, b->proc, b->data, len);
+	dmm_buffer_end_v(&b, &len, 1);
+}
+
+/*
+ * Large page policy: when page_size is set to DMM_LARGE_PAGE_SIZE or
+ * DMM_SECTION_SIZE, buffers of at least that size get memory aligned to it,
+ * from hugetlbfs if there are huge pages reserved, otherwise with a hint for
+ * transparent huge pages, and their DSP mappings get the same alignment.
+ * Physically contiguous chunks then take one MMU entry instead of one per 4K
+ * page. The shared memory segment (dmm_buffer_allocate_sm()) is contiguous
+ * already.
+ */
+static inline bool
+dmm_buffer_large(dmm_buffer_t *b,
+		size_t size)
+{
+	return b->page_size > PAGE_SIZE && size >= b->page_size;
+}
+
+static inline size_t
+dmm_huge_page_size(void)
+{
+	static size_t huge_size = -1;
+	FILE *f;
+	char line[64];
+	unsigned long kb;
+
+	if (huge_size != (size_t) -1)
+		return huge_size;
+
+	huge_size = 0;
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+			huge_size = kb * 1024;
+			break;
+		}
+	}
+	fclose(f);
+
+	return huge_size;
+}
+
+static inline void *
+dmm_buffer_allocate_large(dmm_buffer_t *b,
+		size_t size)
+{
+	size_t page = b->page_size, len;
+	char *p, *aligned;
+#ifdef MAP_HUGETLB
+	size_t huge = dmm_huge_page_size();
+
+	if (huge >= page && size >= huge) {
+		len = ROUND_UP(size, huge);
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			pr_debug("%p: %zu bytes of huge pages", b, len);
+			b->allocated_size = len;
+			return p;
+		}
+	}
+#endif
+
+	/* over-allocate and trim to get the alignment */
+	len = ROUND_UP(size, page);
+	p = mmap(NULL, len + page, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+
+	aligned = (char *) ROUND_UP((unsigned long) p, page);
+	if (aligned != p)
+		munmap(p, aligned - p);
+	if (aligned + len != p + len + page)
+		munmap(aligned + len, p + page - aligned);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+
+	b->allocated_size = len;
+	return aligned;
 }
 
 static inline void
@@ -102,10 +620,36 @@ dmm_buffer_map(dmm_buffer_t *b)
 {
 	size_t to_reserve;
 	pr_debug("%p", b);
+	/* shared memory is always mapped */
+	if (b->sm)
+		return;
+	if (b->entry) {
+		dmm_map_cache_put(b->cache, b->entry);
+		b->entry = NULL;
+		b->map = NULL;
+	}
 	if (b->map)
 		dsp_unmap(b->handle, b->proc, b->map);
 	if (b->reserve)
 		dsp_unreserve(b->handle, b->proc, b->reserve);
+	if (b->cache && b->data != b->allocated_data) {
+		b->reserve = NULL;
+		b->entry = dmm_map_cache_get(b->cache, b->data, b->size, b->dir);
+		b->map = b->entry ? b->entry->map : NULL;
+		return;
+	}
+	if (dmm_buffer_large(b, b->size)) {
+		/*
+		 * Start the mapping at the same alignment as the memory, so the
+		 * MMU can use large entries.
+		 */
+		to_reserve = ROUND_UP(b->size, b->page_size) + b->page_size;
+		dsp_reserve(b->handle, b->proc, to_reserve, &b->reserve);
+		dsp_map(b->handle, b->proc, b->data, b->size,
+				(void *) ROUND_UP((unsigned long) b->reserve, b->page_size),
+				&b->map, 0);
+		return;
+	}
 	/**
 	 * @todo What exactly do we want to do here? Shouldn't the driver
 	 * calculate this?
@@ -119,6 +663,13 @@ static inline void
 dmm_buffer_unmap(dmm_buffer_t *b)
 {
 	pr_debug("%p", b);
+	if (b->sm)
+		return;
+	if (b->entry) {
+		dmm_map_cache_put(b->cache, b->entry);
+		b->entry = NULL;
+		b->map = NULL;
+	}
 	if (b->map) {
 		dsp_unmap(b->handle, b->proc, b->map);
 		b->map = NULL;
@@ -129,13 +680,26 @@ dmm_buffer_unmap(dmm_buffer_t *b)
 	}
 }
 
+static inline void
+dmm_buffer_release_sm(dmm_buffer_t *b)
+{
+	dsp_sm_release(b->sm, b->data);
+	b->sm = NULL;
+	b->data = NULL;
+	b->map = NULL;
+}
+
 static inline void
 dmm_buffer_allocate(dmm_buffer_t *b,
 		size_t size)
 {
 	pr_debug("%p", b);
-	free(b->allocated_data);
-	if (b->alignment != 0) {
+	if (b->sm)
+		dmm_buffer_release_sm(b);
+	dmm_buffer_free_data(b);
+	if (dmm_buffer_large(b, size))
+		b->data = b->allocated_data = dmm_buffer_allocate_large(b, size);
+	else if (b->alignment != 0) {
 		if (posix_memalign(&b->allocated_data, b->alignment, ROUND_UP(size, b->alignment)) != 0)
 			b->allocated_data = NULL;
 		b->data = b->allocated_data;
@@ -143,6 +707,38 @@ dmm_buffer_allocate(dmm_buffer_t *b,
 	else
 		b->data = b->allocated_data = malloc(size);
 	b->size = size;
+	dmm_buffer_dirty_all(b);
+}
+
+/*
+ * Allocates from the shared memory segment; the buffer is mapped right away
+ * and needs no cache maintenance, dmm_buffer_map() and dmm_buffer_unmap()
+ * do nothing. Returns false when the arena is exhausted.
+ */
+static inline bool
+dmm_buffer_allocate_sm(dmm_buffer_t *b,
+		struct dsp_sm *sm,
+		size_t size)
+{
+	uint32_t dsp_addr;
+
+	pr_debug("%p", b);
+	dmm_buffer_unmap(b);
+	if (b->sm)
+		dmm_buffer_release_sm(b);
+	dmm_buffer_free_data(b);
+
+	b->data = dsp_sm_alloc(sm, size, &dsp_addr);
+	if (!b->data)
+		return false;
+
+	b->sm = sm;
+	b->map = (void *) (uintptr_t) dsp_addr;
+	b->size = size;
+	b->nr_dirty = 0;
+	b->all_dirty = false;
+	b->state = DMM_CPU_CLEAN;
+	return true;
 }
 
 static inline void
@@ -151,8 +747,11 @@ dmm_buffer_use(dmm_buffer_t *b,
 		size_t size)
 {
 	pr_debug("%p", b);
+	if (b->sm)
+		dmm_buffer_release_sm(b);
 	b->data = data;
 	b->size = size;
+	dmm_buffer_dirty_all(b);
 }
 
 static inline dmm_buffer_t *
@@ -168,4 +767,114 @@ dmm_buffer_calloc(int handle,
 	return tmp;
 }
 
+/*
+ * Pool of buffers that stay allocated, reserved and mapped while they are
+ * not in use; sizes are rounded up to a power of two.
+ */
+
+#define DMM_POOL_MIN_SHIFT 12
+#define DMM_POOL_CLASSES 12
+
+struct dmm_buffer_pool {
+	int handle;
+	void *proc;
+	dmm_buffer_t *free[DMM_POOL_CLASSES][3];
+	unsigned long hits;
+	unsigned long misses;
+};
+
+static inline int
+dmm_buffer_pool_class(size_t size)
+{
+	int class = 0;
+
+	while (size > ((size_t) 1 << (DMM_POOL_MIN_SHIFT + class))) {
+		if (++class == DMM_POOL_CLASSES)
+			return -1;
+	}
+
+	return class;
+}
+
+static inline struct dmm_buffer_pool *
+dmm_buffer_pool_new(int handle,
+		void *proc)
+{
+	struct dmm_buffer_pool *pool;
+	pool = calloc(1, sizeof(*pool));
+
+	pr_debug("%p", pool);
+	pool->handle = handle;
+	pool->proc = proc;
+
+	return pool;
+}
+
+static inline dmm_buffer_t *
+dmm_buffer_pool_acquire(struct dmm_buffer_pool *pool,
+		size_t size,
+		int dir)
+{
+	dmm_buffer_t *b;
+	int class;
+
+	class = dmm_buffer_pool_class(size);
+	if (class >= 0 && (b = pool->free[class][dir])) {
+		pool->free[class][dir] = b->next;
+		b->next = NULL;
+		pool->hits++;
+		pr_debug("%p: %p", pool, b);
+		b->len = size;
+		dmm_buffer_dirty_all(b);
+		return b;
+	}
+
+	pool->misses++;
+	b = dmm_buffer_new(pool->handle, pool->proc, dir);
+	dmm_buffer_allocate(b, class >= 0 ? (size_t) 1 << (DMM_POOL_MIN_SHIFT + class) : size);
+	dmm_buffer_map(b);
+	pr_debug("%p: %p", pool, b);
+	b->len = size;
+
+	return b;
+}
+
+static inline void
+dmm_buffer_pool_release(struct dmm_buffer_pool *pool,
+		dmm_buffer_t *b)
+{
+	int class;
+
+	pr_debug("%p: %p", pool, b);
+	class = dmm_buffer_pool_class(b->size);
+	if (class < 0 || b->size != (size_t) 1 << (DMM_POOL_MIN_SHIFT + class) ||
+			!b->map || b->data != b->allocated_data) {
+		dmm_buffer_free(b);
+		return;
+	}
+
+	b->next = pool->free[class][b->dir];
+	pool->free[class][b->dir] = b;
+}
+
+static inline void
+dmm_buffer_pool_free(struct dmm_buffer_pool *pool)
+{
+	unsigned int i, j;
+
+	pr_debug("%p", pool);
+	if (!pool)
+		return;
+	for (i = 0; i < DMM_POOL_CLASSES; i++) {
+		for (j = 0; j < 3; j++) {
+			while (pool->free[i][j]) {
+				dmm_buffer_t *b = pool->free[i][j];
+				pool->free[i][j] = b->next;
+				dmm_buffer_free(b);
+			}
+		}
+	}
+	free(pool);
+}
+
 #endif /* DMM_BUFFER_H */
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dsp_bridge.h"
+#include "dmm_buffer.h"
+#include "log.h"
+
+/*
+ * dmm_buffer helpers, checked against the emulator; what dmm_buffer_begin()
+ * and dmm_buffer_end() would flush or invalidate is counted in 'maintained'.
+ */
+
+#define SIZE 0x4000
+
+static int handle;
+static void *proc;
+static unsigned int failures;
+
+static void
+expect(const char *what,
+		dmm_buffer_t *b,
+		unsigned long maintained)
+{
+	if (b->maintained == maintained)
+		return;
+	pr_err("%s: maintained %lu bytes, expected %lu", what, b->maintained, maintained);
+	failures++;
+}
+
+/* a fresh buffer isn't narrowed by a partial write */
+static void
+check_allocate(int dir,
+		const char *what)
+{
+	dmm_buffer_t *b;
+
+	b = dmm_buffer_new(handle, proc, dir);
+	dmm_buffer_allocate(b, SIZE);
+	dmm_buffer_map(b);
+	dmm_buffer_dirty(b, 0, 64);
+	dmm_buffer_begin(b, SIZE);
+	expect(what, b, SIZE);
+
+	/* once the device had it, only the marked range */
+	dmm_buffer_end(b, SIZE);
+	b->maintained = 0;
+	dmm_buffer_dirty(b, 0, 64);
+	dmm_buffer_begin(b, SIZE);
+	expect(what, b, 64);
+
+	dmm_buffer_free(b);
+}
+
+static void
+check_use(void)
+{
+	dmm_buffer_t *b;
+	void *data;
+
+	if (posix_memalign(&data, 128, SIZE)) {
+		pr_err("use: out of memory");
+		failures++;
+		return;
+	}
+	b = dmm_buffer_new(handle, proc, DMA_TO_DEVICE);
+	dmm_buffer_use(b, data, SIZE);
+	dmm_buffer_map(b);
+	dmm_buffer_dirty(b, 128, 64);
+	dmm_buffer_begin(b, SIZE);
+	expect("use", b, SIZE);
+	dmm_buffer_free(b);
+	free(data);
+}
+
+/* a write while the device owns it is reported, and doesn't cancel the invalidate */
+static void
+check_owned(void)
+{
+	dmm_buffer_t *b;
+
+	b = dmm_buffer_new(handle, proc, DMA_BIDIRECTIONAL);
+	dmm_buffer_allocate(b, SIZE);
+	dmm_buffer_map(b);
+	dmm_buffer_begin(b, SIZE);
+	b->maintained = 0;
+	dmm_buffer_dirty(b, 0, 64);
+	dmm_buffer_end(b, SIZE);
+	expect("owned", b, SIZE);
+	dmm_buffer_free(b);
+}
+
+static void
+check_pool(void)
+{
+	struct dmm_buffer_pool *pool;
+	dmm_buffer_t *b, *first;
+
+	pool = dmm_buffer_pool_new(handle, proc);
+
+	first = dmm_buffer_pool_acquire(pool, SIZE, DMA_BIDIRECTIONAL);
+	dmm_buffer_dirty(first, 0, 64);
+	dmm_buffer_begin(first, SIZE);
+	expect("pool miss", first, SIZE);
+	dmm_buffer_end(first, SIZE);
+	dmm_buffer_pool_release(pool, first);
+
+	/* the same buffer comes back for the same size class, still mapped */
+	b = dmm_buffer_pool_acquire(pool, SIZE - 64, DMA_BIDIRECTIONAL);
+	if (b != first || !b->map || b->len != SIZE - 64 || pool->hits != 1) {
+		pr_err("pool: expected a hit");
+		failures++;
+	}
+	/* and whatever the last user wrote is flushed */
+	b->maintained = 0;
+	dmm_buffer_dirty(b, 0, 64);
+	dmm_buffer_begin(b, SIZE);
+	expect("pool hit", b, SIZE);
+	dmm_buffer_end(b, SIZE);
+	dmm_buffer_pool_release(pool, b);
+
+	/* but not for another direction */
+	b = dmm_buffer_pool_acquire(pool, SIZE, DMA_TO_DEVICE);
+	if (b == first || pool->misses != 2) {
+		pr_err("pool: expected a miss");
+		failures++;
+	}
+	dmm_buffer_pool_release(pool, b);
+
+	dmm_buffer_pool_free(pool);
+}
+
+/* the user's memory is mapped once, and the budget holds */
+static void
+check_map_cache(void)
+{
+	struct dmm_map_cache *cache;
+	dmm_buffer_t *b;
+	void *data[3];
+	unsigned int i;
+
+	for (i = 0; i < 3; i++) {
+		if (posix_memalign(&data[i], 128, SIZE)) {
+			pr_err("map cache: out of memory");
+			failures++;
+			while (i--)
+				free(data[i]);
+			return;
+		}
+	}
+
+	cache = dmm_map_cache_new(handle, proc, 2 * SIZE);
+
+	for (i = 0; i < 4; i++) {
+		b = dmm_buffer_new(handle, proc, DMA_TO_DEVICE);
+		b->cache = cache;
+		dmm_buffer_use(b, data[i % 2], SIZE);
+		dmm_buffer_map(b);
+		dmm_buffer_free(b);
+	}
+	if (cache->hits != 2 || cache->misses != 2) {
+		pr_err("map cache: %lu hits, %lu misses, expected 2 each",
+				cache->hits, cache->misses);
+		failures++;
+	}
+
+	/* a third one doesn't fit along the other two */
+	b = dmm_buffer_new(handle, proc, DMA_TO_DEVICE);
+	b->cache = cache;
+	dmm_buffer_use(b, data[2], SIZE);
+	dmm_buffer_map(b);
+	dmm_buffer_free(b);
+	if (cache->evictions != 1 || cache->mapped > 2 * SIZE) {
+		pr_err("map cache: expected an eviction");
+		failures++;
+	}
+
+	dmm_map_cache_free(cache);
+	for (i = 0; i < 3; i++)
+		free(data[i]);
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	handle = dsp_open();
+	if (handle < 0) {
+		pr_err("dsp open failed");
+		return -1;
+	}
+
+	if (!dsp_attach(handle, 0, NULL, &proc)) {
+		pr_err("dsp attach failed");
+		ret = -1;
+		goto leave;
+	}
+
+	check_allocate(DMA_TO_DEVICE, "allocate");
+	check_allocate(DMA_BIDIRECTIONAL, "allocate bidirectional");
+	check_use();
+	check_owned();
+	check_pool();
+	check_map_cache();
+
+	if (failures) {
+		pr_err("%u checks failed", failures);
+		ret = -1;
+	}
+
+	if (!dsp_detach(handle, proc)) {
+		pr_err("dsp detach failed");
+		ret = -1;
+	}
+
+leave:
+	if (dsp_close(handle) < 0) {
+		pr_err("dsp close failed");
+		ret = -1;
+	}
+
+	return ret;
+}
@@ -11,6 +11,8 @@
  */
 
 #include "dsp_bridge.h"
+#include "dsp_ioctl.h"
+#include "log.h"
 
 /* for open */
 #include <sys/types.h>
@@ -22,152 +24,461 @@
 #include <stdlib.h> /* for free */
 
 #include <malloc.h> /* for memalign */
+#include <string.h> /* for memset */
 
 #define ALLOCATE_SM
 
+#ifdef ALLOCATE_HEAP
+#include <pthread.h>
+#endif
+
 #ifdef ALLOCATE_SM
 #include <malloc.h> /* for memalign */
 #include <sys/mman.h> /* for mmap */
+#include <pthread.h>
 #endif
 
 #if DSP_API < 2
 #include <errno.h>
 #endif
 
-/*
- * Dspbridge ioctl numbering scheme
- *
- *    7                           0
- *  ---------------------------------
- *  |  Module   |   ioctl Number    |
- *  ---------------------------------
- *  | x | x | x | 0 | 0 | 0 | 0 | 0 |
- *  ---------------------------------
- */
+#ifdef DSP_EMULATOR
+#include "dsp_emu.h"
+#endif
+
+#define IOCTL_STATS
 
-/* ioctl driver identifier */
-#define DB 0xDB
+#ifdef IOCTL_STATS
+#include <pthread.h>
+#include <string.h> /* for memset */
+#include <time.h>
+#endif
+
+static inline int real_ioctl(int fd, unsigned long r, void *arg)
+{
+#ifdef DSP_EMULATOR
+	if (dsp_emu_handle(fd))
+		return dsp_emu_ioctl(fd, r, arg);
+#endif
+	return ioctl(fd, r, arg);
+}
+
+#ifdef IOCTL_STATS
+
+/* ioctl numbers fit in a byte on every API version */
+#define STATS_SIZE 256
+#define STATS_INDEX(r) ((r) & (STATS_SIZE - 1))
 
 /*
- * Following are used to distinguish between module ioctls, this is needed
- * in case new ioctls are introduced.
+ * One table per thread, only ever written by its owner. Readers sum them up
+ * with relaxed loads; a reset bumps the epoch and each owner clears its table
+ * on its next call, so the single-writer rule still holds.
  */
-#define DB_MODULE_MASK 0xE0
-#define DB_IOC_MASK    0x1F
+struct stats_table {
+	struct stats_table *next;
+	unsigned int epoch;
+	struct dsp_ioctl_stats entries[STATS_SIZE];
+};
 
-#if DSP_API >= 1
+static struct stats_table *stats_tables;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int stats_epoch;
+static __thread struct stats_table *stats_local;
 
-#include <linux/ioctl.h>
+#define STAT_ADD(field, v) __atomic_store_n(&(field), (field) + (v), __ATOMIC_RELAXED)
+#define STAT_SET(field, v) __atomic_store_n(&(field), (v), __ATOMIC_RELAXED)
 
-/* ioctl module masks */
-#define DB_MGR  0x0
-#define DB_PROC 0x20
-#define DB_NODE 0x40
-#define DB_STRM 0x60
-#define DB_CMM  0x80
+static struct stats_table *get_stats_table(void)
+{
+	struct stats_table *t = stats_local;
+	unsigned int epoch = __atomic_load_n(&stats_epoch, __ATOMIC_ACQUIRE);
+
+	if (!t) {
+		/* never freed; tables of exited threads keep their counts */
+		t = calloc(1, sizeof(*t));
+		if (!t)
+			return NULL;
+		t->epoch = epoch;
+		pthread_mutex_lock(&stats_lock);
+		t->next = stats_tables;
+		__atomic_store_n(&stats_tables, t, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&stats_lock);
+		stats_local = t;
+	} else if (t->epoch != epoch) {
+		memset(t->entries, 0, sizeof(t->entries));
+		__atomic_store_n(&t->epoch, epoch, __ATOMIC_RELEASE);
+	}
+
+	return t;
+}
 
-/* Used to calculate the ioctl per dspbridge module */
-#define DB_IOC(module, num) \
-	(((module) & DB_MODULE_MASK) | ((num) & DB_IOC_MASK))
+static inline uint64_t stats_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int timed_ioctl(int fd, unsigned long r, void *arg)
+{
+	struct stats_table *t;
+	struct dsp_ioctl_stats *s;
+	uint64_t start, delta;
+	unsigned int bucket;
+	int ret;
+
+	start = stats_now();
+	ret = real_ioctl(fd, r, arg);
+	delta = stats_now() - start;
+
+	t = get_stats_table();
+	if (!t)
+		return ret;
+
+	s = &t->entries[STATS_INDEX(r)];
+	if (!s->count) {
+		STAT_SET(s->request, r);
+		STAT_SET(s->min_ns, delta);
+	}
+	STAT_ADD(s->count, 1);
+	if (ret < 0)
+		STAT_ADD(s->errors, 1);
+	STAT_ADD(s->total_ns, delta);
+	if (delta < s->min_ns)
+		STAT_SET(s->min_ns, delta);
+	if (delta > s->max_ns)
+		STAT_SET(s->max_ns, delta);
+	bucket = delta ? 63 - __builtin_clzll(delta) : 0;
+	if (bucket >= DSP_STATS_BUCKETS)
+		bucket = DSP_STATS_BUCKETS - 1;
+	STAT_ADD(s->histogram[bucket], 1);
+
+	return ret;
+}
+
+unsigned int dsp_bridge_get_stats(struct dsp_ioctl_stats *stats,
+		unsigned int count)
+{
+	struct dsp_ioctl_stats *sum;
+	struct stats_table *t;
+	unsigned int i, j, n = 0;
+	unsigned int epoch = __atomic_load_n(&stats_epoch, __ATOMIC_ACQUIRE);
+
+	sum = calloc(STATS_SIZE, sizeof(*sum));
+	if (!sum)
+		return 0;
+
+	for (t = __atomic_load_n(&stats_tables, __ATOMIC_ACQUIRE); t; t = t->next) {
+		/* not cleared by its owner yet */
+		if (__atomic_load_n(&t->epoch, __ATOMIC_ACQUIRE) != epoch)
+			continue;
+
+		for (i = 0; i < STATS_SIZE; i++) {
+			struct dsp_ioctl_stats *s = &t->entries[i], *d = &sum[i];
+			uint64_t c = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+			uint64_t min = __atomic_load_n(&s->min_ns, __ATOMIC_RELAXED);
+			uint64_t max = __atomic_load_n(&s->max_ns, __ATOMIC_RELAXED);
+
+			if (!c)
+				continue;
+			if (!d->count || min < d->min_ns)
+				d->min_ns = min;
+			if (max > d->max_ns)
+				d->max_ns = max;
+			d->request = __atomic_load_n(&s->request, __ATOMIC_RELAXED);
+			d->count += c;
+			d->errors += __atomic_load_n(&s->errors, __ATOMIC_RELAXED);
+			d->total_ns += __atomic_load_n(&s->total_ns, __ATOMIC_RELAXED);
+			for (j = 0; j < DSP_STATS_BUCKETS; j++)
+				d->histogram[j] += __atomic_load_n(&s->histogram[j], __ATOMIC_RELAXED);
+		}
+	}
+
+	for (i = 0; i < STATS_SIZE && n < count; i++)
+		if (sum[i].count)
+			stats[n++] = sum[i];
+
+	free(sum);
+	return n;
+}
+
+void dsp_bridge_reset_stats(void)
+{
+	__atomic_fetch_add(&stats_epoch, 1, __ATOMIC_RELEASE);
+}
 
 #else
 
-#define DB_MGR  1
-#define DB_PROC 7
-#define DB_NODE 24
-#define DB_STRM 39
-#define DB_CMM  50
-
-#define DB_IOC(module, num)	((module) + (num))
-
-#undef _IOR
-#undef _IOW
-#undef _IOWR
-
-#define _IOR(type, nr, size)	(nr)
-#define _IOW(type, nr, size)	(nr)
-#define _IOWR(type, nr, size)	(nr)
-
-#endif /* DSP_API */
-
-/* MGR Module */
-#define MGR_WAIT		_IOWR(DB, DB_IOC(DB_MGR, 4), unsigned long)
-#define MGR_ENUMNODE_INFO	_IOWR(DB, DB_IOC(DB_MGR, 0), unsigned long)
-#define MGR_REGISTEROBJECT	_IOWR(DB, DB_IOC(DB_MGR, 2), unsigned long)
-#define MGR_UNREGISTEROBJECT	_IOWR(DB, DB_IOC(DB_MGR, 3), unsigned long)
-
-/* PROC Module */
-#define PROC_ATTACH		_IOWR(DB, DB_IOC(DB_PROC, 0), unsigned long)
-/* PROC_DETACH Deprecated */
-#define PROC_DETACH		_IOR(DB, DB_IOC(DB_PROC, 2), unsigned long)
-#define PROC_REGISTERNOTIFY	_IOWR(DB, DB_IOC(DB_PROC, 8), unsigned long)
-#define PROC_RSVMEM		_IOWR(DB, DB_IOC(DB_PROC, 10), unsigned long)
-#define PROC_UNRSVMEM		_IOW(DB, DB_IOC(DB_PROC, 11), unsigned long)
-#define PROC_MAPMEM		_IOWR(DB, DB_IOC(DB_PROC, 12), unsigned long)
-#define PROC_UNMAPMEM		_IOR(DB, DB_IOC(DB_PROC, 13), unsigned long)
-#define PROC_FLUSHMEMORY	_IOW(DB, DB_IOC(DB_PROC, 14), unsigned long)
-#define PROC_INVALIDATEMEMORY	_IOW(DB, DB_IOC(DB_PROC, 16), unsigned long)
-#define PROC_GET_STATE		_IOWR(DB, DB_IOC(DB_PROC, 5), unsigned long)
-#define PROC_ENUMRESOURCES	_IOWR(DB, DB_IOC(DB_PROC, 4), unsigned long)
-#define PROC_ENUMNODE		_IOWR(DB, DB_IOC(DB_PROC, 3), unsigned long)
-#define PROC_STOP               _IOWR(DB, DB_IOC(DB_PROC, 15), unsigned long)
-#define PROC_LOAD               _IOW(DB, DB_IOC(DB_PROC, 7), unsigned long)
-#define PROC_START              _IOW(DB, DB_IOC(DB_PROC, 9), unsigned long)
-
-/* NODE Module */
-#define NODE_REGISTERNOTIFY	_IOWR(DB, DB_IOC(DB_NODE, 11), unsigned long)
-#define NODE_CREATE		_IOW(DB, DB_IOC(DB_NODE, 4), unsigned long)
-#define NODE_RUN		_IOW(DB, DB_IOC(DB_NODE, 12), unsigned long)
-#define NODE_TERMINATE		_IOWR(DB, DB_IOC(DB_NODE, 13), unsigned long)
-#define NODE_PUTMESSAGE		_IOW(DB, DB_IOC(DB_NODE, 10), unsigned long)
-#define NODE_GETMESSAGE		_IOWR(DB, DB_IOC(DB_NODE, 8), unsigned long)
-#define NODE_DELETE		_IOW(DB, DB_IOC(DB_NODE, 5), unsigned long)
-#define NODE_GETATTR		_IOWR(DB, DB_IOC(DB_NODE, 7), unsigned long)
-#define NODE_ALLOCMSGBUF	_IOWR(DB, DB_IOC(DB_NODE, 1), unsigned long)
-#define NODE_GETUUIDPROPS	_IOWR(DB, DB_IOC(DB_NODE, 14), unsigned long)
-#define NODE_ALLOCATE		_IOWR(DB, DB_IOC(DB_NODE, 0), unsigned long)
-#define NODE_CONNECT		_IOW(DB, DB_IOC(DB_NODE, 3), unsigned long)
-
-/* CMM Module */
-#define CMM_GETHANDLE		_IOR(DB, DB_IOC(DB_CMM, 2), unsigned long)
-#define CMM_GETINFO		_IOR(DB, DB_IOC(DB_CMM, 3), unsigned long)
-
-/* STRM Module */
-#define STRM_OPEN		_IOWR(DB, DB_IOC(DB_STRM, 7), unsigned long)
-#define STRM_CLOSE		_IOW(DB, DB_IOC(DB_STRM, 1), unsigned long)
-#define STRM_GETINFO		_IOWR(DB, DB_IOC(DB_STRM, 4), unsigned long)
-#define STRM_ALLOCATEBUFFER	_IOWR(DB, DB_IOC(DB_STRM, 0), unsigned long)
-#define STRM_IDLE		_IOW(DB, DB_IOC(DB_STRM, 5), unsigned long)
-#define STRM_RECLAIM		_IOWR(DB, DB_IOC(DB_STRM, 8), unsigned long)
-#define STRM_FREEBUFFER		_IOWR(DB, DB_IOC(DB_STRM, 2), unsigned long)
-#define STRM_ISSUE		_IOW(DB, DB_IOC(DB_STRM, 6), unsigned long)
+static inline int timed_ioctl(int fd, unsigned long r, void *arg)
+{
+	return real_ioctl(fd, r, arg);
+}
 
-#if DSP_API < 2
-static inline int real_ioctl(int fd, int r, void *arg)
+unsigned int dsp_bridge_get_stats(struct dsp_ioctl_stats *stats,
+		unsigned int count)
+{
+	return 0;
+}
+
+void dsp_bridge_reset_stats(void)
 {
-	return ioctl(fd, r, arg);
 }
-#endif
+
+#endif /* IOCTL_STATS */
+
+const char *dsp_ioctl_name(unsigned long request)
+{
+	switch (request) {
+#define CASE(r) case r: return #r
+	CASE(MGR_WAIT);
+	CASE(MGR_ENUMNODE_INFO);
+	CASE(MGR_REGISTEROBJECT);
+	CASE(MGR_UNREGISTEROBJECT);
+	CASE(PROC_ATTACH);
+	CASE(PROC_DETACH);
+	CASE(PROC_REGISTERNOTIFY);
+	CASE(PROC_START);
+	CASE(PROC_STOP);
+	CASE(PROC_RSVMEM);
+	CASE(PROC_UNRSVMEM);
+	CASE(PROC_MAPMEM);
+	CASE(PROC_UNMAPMEM);
+	CASE(PROC_FLUSHMEMORY);
+	CASE(PROC_INVALIDATEMEMORY);
+	CASE(PROC_GET_STATE);
+	CASE(PROC_ENUMRESOURCES);
+	CASE(PROC_LOAD);
+	CASE(PROC_ENUMNODE);
+	CASE(NODE_ALLOCATE);
+	CASE(NODE_ALLOCMSGBUF);
+	CASE(NODE_FREEMSGBUF);
+	CASE(NODE_GETATTR);
+	CASE(NODE_CONNECT);
+	CASE(NODE_CREATE);
+	CASE(NODE_DELETE);
+	CASE(NODE_GETMESSAGE);
+	CASE(NODE_PUTMESSAGE);
+	CASE(NODE_REGISTERNOTIFY);
+	CASE(NODE_RUN);
+	CASE(NODE_TERMINATE);
+	CASE(NODE_GETUUIDPROPS);
+	CASE(STRM_OPEN);
+	CASE(STRM_CLOSE);
+	CASE(STRM_IDLE);
+	CASE(STRM_RECLAIM);
+	CASE(STRM_ISSUE);
+	CASE(STRM_GETINFO);
+	CASE(STRM_ALLOCATEBUFFER);
+	CASE(STRM_FREEBUFFER);
+	CASE(CMM_GETHANDLE);
+	CASE(CMM_GETINFO);
+#undef CASE
+	default: return "unknown";
+	}
+}
 
 /* will not be needed when tidspbridge uses proper error codes */
-#define ioctl(...) (ioctl(__VA_ARGS__) < 0)
+#define ioctl(...) (timed_ioctl(__VA_ARGS__) < 0)
+
+#ifdef ALLOCATE_SM
+
+/*
+ * The CMM layout doesn't change while the bridge is up, so it's queried once
+ * per handle, and segment 0 is mapped once and shared by every node and
+ * stream opened through that handle.
+ */
+struct cmm_cache {
+	struct cmm_cache *next;
+	int handle;
+	struct dsp_cmm_info info;
+	void *base;
+	size_t size;
+	unsigned int refs;
+};
+
+static struct cmm_cache *cmm_caches;
+static pthread_mutex_t cmm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline bool query_cmm_info(int handle,
+		void *proc_handle,
+		struct dsp_cmm_info *cmm_info)
+{
+	struct cmm_object *cmm;
+	struct cmm_get_handle cmm_arg = {
+		.proc_handle = proc_handle,
+		.cmm = &cmm,
+	};
+	struct cmm_get_info cmm_info_arg = {
+		.info = cmm_info,
+	};
+
+	if (ioctl(handle, CMM_GETHANDLE, &cmm_arg))
+		return false;
+
+	cmm_info_arg.cmm = cmm;
+	if (ioctl(handle, CMM_GETINFO, &cmm_info_arg))
+		return false;
+
+	return true;
+}
+
+/* called with cmm_lock held */
+static struct cmm_cache *get_cmm_cache(int handle,
+		void *proc_handle)
+{
+	struct cmm_cache *c;
+
+	for (c = cmm_caches; c; c = c->next)
+		if (c->handle == handle)
+			return c;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+
+	if (!query_cmm_info(handle, proc_handle, &c->info)) {
+		free(c);
+		return NULL;
+	}
+
+	c->handle = handle;
+	c->next = cmm_caches;
+	cmm_caches = c;
+
+	return c;
+}
+
+static inline bool get_cmm_info(int handle,
+		void *proc_handle,
+		struct dsp_cmm_info *cmm_info)
+{
+	struct cmm_cache *c;
+
+	pthread_mutex_lock(&cmm_lock);
+	c = get_cmm_cache(handle, proc_handle);
+	if (c)
+		*cmm_info = c->info;
+	pthread_mutex_unlock(&cmm_lock);
+
+	return c != NULL;
+}
+
+/*
+ * Takes a reference on the mapping of segment 0; *base is NULL when there's
+ * no segment to map.
+ */
+static bool get_segment(int handle,
+		void *proc_handle,
+		void **base,
+		size_t *size)
+{
+	struct cmm_cache *c;
+	struct dsp_cmm_seg_info *seg;
+	bool ret = false;
+
+	*base = NULL;
+
+	pthread_mutex_lock(&cmm_lock);
+	c = get_cmm_cache(handle, proc_handle);
+	if (!c)
+		goto leave;
+
+	seg = &c->info.info[0];
+	if (c->info.segments == 0 || seg->base_pa == 0 || seg->size == 0) {
+		ret = true;
+		goto leave;
+	}
+
+	if (!c->refs) {
+		void *addr;
+
+		addr = mmap(NULL, seg->size,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | 0x2000 /* MAP_LOCKED */,
+				handle, seg->base_pa);
+		if (addr == MAP_FAILED)
+			goto leave;
+
+		c->base = addr;
+		c->size = seg->size;
+	}
+
+	c->refs++;
+	*base = c->base;
+	*size = c->size;
+	ret = true;
+leave:
+	pthread_mutex_unlock(&cmm_lock);
+	return ret;
+}
+
+static bool put_segment(int handle,
+		void *base)
+{
+	struct cmm_cache *c;
+	bool ret = false;
+
+	pthread_mutex_lock(&cmm_lock);
+	for (c = cmm_caches; c; c = c->next)
+		if (c->handle == handle)
+			break;
+
+	if (!c || !c->refs || c->base != base)
+		goto leave;
+
+	ret = true;
+	if (--c->refs == 0) {
+		ret = !munmap(c->base, c->size);
+		c->base = NULL;
+	}
+leave:
+	pthread_mutex_unlock(&cmm_lock);
+	return ret;
+}
+
+/* the handle number can be reused after close */
+static void drop_cmm_cache(int handle)
+{
+	struct cmm_cache **p, *c;
+
+	pthread_mutex_lock(&cmm_lock);
+	for (p = &cmm_caches; (c = *p); p = &c->next) {
+		if (c->handle != handle)
+			continue;
+		*p = c->next;
+		if (c->refs) {
+			pr_warning("segment still mapped, %u references", c->refs);
+			munmap(c->base, c->size);
+		}
+		free(c);
+		break;
+	}
+	pthread_mutex_unlock(&cmm_lock);
+}
+
+#endif /* ALLOCATE_SM */
 
 int dsp_open(void)
 {
+#ifdef DSP_EMULATOR
+	if (getenv("DSP_EMULATOR"))
+		return dsp_emu_open();
+#endif
 	return open("/dev/DspBridge", O_RDWR);
 }
 
 int dsp_close(int handle)
 {
+#ifdef ALLOCATE_SM
+	drop_cmm_cache(handle);
+#endif
+#ifdef DSP_EMULATOR
+	if (dsp_emu_handle(handle))
+		return dsp_emu_close(handle);
+#endif
 	return close(handle);
 }
 
-struct proc_attach {
-	unsigned int num;
-	const void *info; /* not used */
-	void **ret_handle;
-};
-
 bool dsp_attach(int handle,
 		unsigned int num,
 		const void *info,
@@ -182,10 +493,6 @@ bool dsp_attach(int handle,
 	return !ioctl(handle, PROC_ATTACH, &arg);
 }
 
-struct proc_detach {
-	void *proc_handle;
-};
-
 bool dsp_detach(int handle,
 		void *proc_handle)
 {
@@ -196,13 +503,6 @@ bool dsp_detach(int handle,
 	return !ioctl(handle, PROC_DETACH, &arg);
 }
 
-struct register_notify {
-	void *proc_handle;
-	unsigned int event_mask;
-	unsigned int notify_type;
-	struct dsp_notification *info;
-};
-
 bool dsp_register_notify(int handle,
 		void *proc_handle,
 		unsigned int event_mask,
@@ -219,10 +519,6 @@ bool dsp_register_notify(int handle,
 	return !ioctl(handle, PROC_REGISTERNOTIFY, &arg);
 }
 
-struct proc_start {
-	void *proc_handle;
-};
-
 bool dsp_start(int handle,
 		void *proc_handle)
 {
@@ -243,13 +539,6 @@ bool dsp_stop(int handle,
 	return !ioctl(handle, PROC_STOP, &arg);
 }
 
-struct proc_load {
-	void *proc_handle;
-	int argc;
-	char **argv;
-	char **env;
-};
-
 bool dsp_load(int handle,
 		void *proc_handle,
 		int argc, char **argv,
@@ -265,13 +554,6 @@ bool dsp_load(int handle,
 	return !ioctl(handle, PROC_LOAD, &arg);
 }
 
-struct node_register_notify {
-	void *node_handle;
-	unsigned int event_mask;
-	unsigned int notify_type;
-	struct dsp_notification *info;
-};
-
 bool dsp_node_register_notify(int handle,
 		struct dsp_node *node,
 		unsigned int event_mask,
@@ -288,13 +570,6 @@ bool dsp_node_register_notify(int handle,
 	return !ioctl(handle, NODE_REGISTERNOTIFY, &arg);
 }
 
-struct wait_for_events {
-	struct dsp_notification **notifications;
-	unsigned int count;
-	unsigned int *ret_index;
-	unsigned int timeout;
-};
-
 bool dsp_wait_for_events(int handle,
 		struct dsp_notification **notifications,
 		unsigned int count,
@@ -316,20 +591,13 @@ bool dsp_wait_for_events(int handle,
 	 * is not stored.
 	 */
 	int r;
-	r = real_ioctl(handle, MGR_WAIT, &arg);
+	r = timed_ioctl(handle, MGR_WAIT, &arg);
 	if (r == (int)0x80008017)
 		errno = ETIME;
 	return r >= 0;
 #endif
 }
 
-struct enum_node {
-	unsigned int num;
-	struct dsp_ndb_props *info;
-	unsigned int info_size;
-	unsigned int *ret_num;
-};
-
 bool dsp_enum(int handle,
 		unsigned int num,
 		struct dsp_ndb_props *info,
@@ -346,12 +614,6 @@ bool dsp_enum(int handle,
 	return !ioctl(handle, MGR_ENUMNODE_INFO, &arg);
 }
 
-struct register_object {
-	const struct dsp_uuid *uuid;
-	enum dsp_dcd_object_type type;
-	const char *path;
-};
-
 bool dsp_register(int handle,
 		const struct dsp_uuid *uuid,
 		enum dsp_dcd_object_type type,
@@ -366,11 +628,6 @@ bool dsp_register(int handle,
 	return !ioctl(handle, MGR_REGISTEROBJECT, &arg);
 }
 
-struct unregister_object {
-	const struct dsp_uuid *uuid;
-	enum dsp_dcd_object_type type;
-};
-
 bool dsp_unregister(int handle,
 		const struct dsp_uuid *uuid,
 		enum dsp_dcd_object_type type)
@@ -383,10 +640,6 @@ bool dsp_unregister(int handle,
 	return !ioctl(handle, MGR_UNREGISTEROBJECT, &arg);
 }
 
-struct node_create {
-	void *node_handle;
-};
-
 bool dsp_node_create(int handle,
 		struct dsp_node *node)
 {
@@ -397,10 +650,6 @@ bool dsp_node_create(int handle,
 	return !ioctl(handle, NODE_CREATE, &arg);
 }
 
-struct node_run {
-	void *node_handle;
-};
-
 bool dsp_node_run(int handle,
 		struct dsp_node *node)
 {
@@ -411,11 +660,6 @@ bool dsp_node_run(int handle,
 	return !ioctl(handle, NODE_RUN, &arg);
 }
 
-struct node_terminate {
-	void *node_handle;
-	unsigned long *status;
-};
-
 bool dsp_node_terminate(int handle,
 		struct dsp_node *node,
 		unsigned long *status)
@@ -428,12 +672,6 @@ bool dsp_node_terminate(int handle,
 	return !ioctl(handle, NODE_TERMINATE, &arg);
 }
 
-struct node_put_message {
-	void *node_handle;
-	const struct dsp_msg *message;
-	unsigned int timeout;
-};
-
 bool dsp_node_put_message(int handle,
 		struct dsp_node *node,
 		const struct dsp_msg *message,
@@ -448,12 +686,6 @@ bool dsp_node_put_message(int handle,
 	return !ioctl(handle, NODE_PUTMESSAGE, &arg);
 }
 
-struct node_get_message {
-	void *node_handle;
-	struct dsp_msg *message;
-	unsigned int timeout;
-};
-
 bool dsp_node_get_message(int handle,
 		struct dsp_node *node,
 		struct dsp_msg *message,
@@ -468,10 +700,6 @@ bool dsp_node_get_message(int handle,
 	return !ioctl(handle, NODE_GETMESSAGE, &arg);
 }
 
-struct node_delete {
-	void *node_handle;
-};
-
 static inline bool dsp_node_delete(int handle,
 		struct dsp_node *node)
 {
@@ -483,12 +711,6 @@ static inline bool dsp_node_delete(int handle,
 }
 
 #ifdef ALLOCATE_SM
-struct node_get_attr {
-	void *node_handle;
-	struct dsp_node_attr *attr;
-	unsigned int attr_size;
-};
-
 bool dsp_node_get_attr(int handle,
 		struct dsp_node *node,
 		struct dsp_node_attr *attr,
@@ -503,19 +725,6 @@ bool dsp_node_get_attr(int handle,
 	return !ioctl(handle, NODE_GETATTR, &arg);
 }
 
-struct dsp_buffer_attr {
-	unsigned long cb;
-	unsigned int segment;
-	unsigned int alignment;
-};
-
-struct node_alloc_buf {
-	void *node_handle;
-	unsigned int size;
-	struct dsp_buffer_attr *attr;
-	void **buffer;
-};
-
 static inline bool dsp_node_alloc_buf(int handle,
 		struct dsp_node *node,
 		size_t size,
@@ -537,115 +746,98 @@ static inline bool dsp_node_alloc_buf(int handle,
 	return true;
 }
 
-struct dsp_cmm_seg_info {
-	unsigned long base_pa;
-	unsigned long size;
-	unsigned long gpp_base_pa;
-	unsigned long gpp_size;
-	unsigned long dsp_base_va;
-	unsigned long dsp_size;
-	unsigned long use_count;
-	unsigned long base_va;
-};
+static inline bool allocate_segments(int handle,
+		void *proc_handle,
+		struct dsp_node *node)
+{
+	struct dsp_node_attr attr;
+	struct dsp_buffer_attr buffer_attr;
+	void *base, *buffer;
+	size_t size;
 
-struct dsp_cmm_info {
-	unsigned long segments;
-	unsigned long use_count;
-	unsigned long min_block_size;
-	struct dsp_cmm_seg_info info[1];
-};
+	if (!dsp_node_get_attr(handle, node, &attr, sizeof(attr)))
+		return false;
 
-struct cmm_get_handle {
-	void *proc_handle;
-	struct cmm_object **cmm;
-};
+	if (attr.info.props.ntype == DSP_NODE_DEVICE)
+		return true;
 
-struct cmm_get_info {
-	struct cmm_object *cmm;
-	struct dsp_cmm_info *info;
-};
+	if (!get_segment(handle, proc_handle, &base, &size))
+		return false;
 
-static inline bool get_cmm_info(int handle,
-		void *proc_handle,
-		struct dsp_cmm_info *cmm_info)
-{
-	struct cmm_object *cmm;
-	struct cmm_get_handle cmm_arg = {
-		.proc_handle = proc_handle,
-		.cmm = &cmm,
-	};
-	struct cmm_get_info cmm_info_arg = {
-		.info = cmm_info,
-	};
+	if (!base)
+		return true;
 
-	if (ioctl(handle, CMM_GETHANDLE, &cmm_arg))
+	buffer_attr.alignment = 0;
+	buffer_attr.segment = 1 | 0x10000000;
+	buffer_attr.cb = 0;
+	/* on failure the buffer is cleared, and the reference is on base */
+	buffer = base;
+	if (!dsp_node_alloc_buf(handle, node, size, &buffer_attr, &buffer)) {
+		put_segment(handle, base);
 		return false;
+	}
 
-	cmm_info_arg.cmm = cmm;
-	if (ioctl(handle, CMM_GETINFO, &cmm_info_arg))
-		return false;
+	node->msgbuf_addr = base;
+	node->msgbuf_size = size;
 
 	return true;
 }
+#endif
 
-static inline bool allocate_segments(int handle,
-		void *proc_handle,
-		struct dsp_node *node)
+bool dsp_node_alloc_sm(int handle,
+		struct dsp_node *node,
+		size_t size,
+		void **buffer,
+		uint32_t *dsp_addr)
 {
+#ifdef ALLOCATE_SM
 	struct dsp_cmm_info cmm_info;
-	struct dsp_node_attr attr;
-	enum dsp_node_type node_type;
+	struct dsp_buffer_attr buffer_attr = {
+		.segment = 1,
+		.alignment = 128,
+	};
 
-	if (!get_cmm_info(handle, proc_handle, &cmm_info))
+	/* the segment has to be mapped for the node already */
+	if (!node->msgbuf_addr)
 		return false;
 
-	if (!dsp_node_get_attr(handle, node, &attr, sizeof(attr)))
+	if (!get_cmm_info(handle, NULL, &cmm_info) || cmm_info.segments == 0)
 		return false;
 
-	node_type = attr.info.props.ntype;
-
-	if ((node_type != DSP_NODE_DEVICE) && (cmm_info.segments > 0)) {
-		struct dsp_cmm_seg_info *seg;
-
-		seg = &cmm_info.info[0];
-
-		if (seg->base_pa != 0 && seg->size > 0) {
-			void *base;
-			struct dsp_buffer_attr buffer_attr;
-
-			base = mmap(NULL, seg->size,
-					PROT_READ | PROT_WRITE, MAP_SHARED | 0x2000 /* MAP_LOCKED */,
-					handle, seg->base_pa);
-
-			if (!base)
-				return false;
-
-			buffer_attr.alignment = 0;
-			buffer_attr.segment = 1 | 0x10000000;
-			buffer_attr.cb = 0;
-			if (!dsp_node_alloc_buf(handle, node, seg->size,
-						&buffer_attr, &base))
-			{
-				munmap(base, seg->size);
-				return false;
-			}
+	if (!dsp_node_alloc_buf(handle, node, size, &buffer_attr, buffer))
+		return false;
 
-			node->msgbuf_addr = base;
-			node->msgbuf_size = seg->size;
-		}
-	}
+	*dsp_addr = cmm_info.info[0].dsp_base_va +
+		((char *) *buffer - (char *) node->msgbuf_addr);
 
 	return true;
+#else
+	return false;
+#endif
 }
+
+bool dsp_node_free_sm(int handle,
+		struct dsp_node *node,
+		void *buffer)
+{
+#ifdef ALLOCATE_SM
+	struct dsp_buffer_attr buffer_attr = {
+		.segment = 1,
+		.alignment = 128,
+	};
+	struct node_free_buf arg = {
+		.node_handle = node->handle,
+		.buffer = buffer,
+		.attr = &buffer_attr,
+	};
+
+	return !ioctl(handle, NODE_FREEMSGBUF, &arg);
+#else
+	return false;
 #endif
+}
 
 #ifdef ALLOCATE_HEAP
-struct get_uuid_props {
-	void *proc_handle;
-	const struct dsp_uuid *node_uuid;
-	struct dsp_ndb_props *props;
-};
-
 static inline bool get_uuid_props(int handle,
 		void *proc_handle,
 		const struct dsp_uuid *node_uuid,
@@ -664,16 +856,120 @@ static inline bool get_uuid_props(int handle,
 #define PG_MASK(pg_size) (~((pg_size)-1))
 #define PG_ALIGN_LOW(addr, pg_size) ((addr) & PG_MASK(pg_size))
 #define PG_ALIGN_HIGH(addr, pg_size) (((addr)+(pg_size)-1) & PG_MASK(pg_size))
-#endif
 
-struct node_allocate {
-	void *proc_handle;
-	const struct dsp_uuid *node_id;
-	const void *cb_data;
-	struct dsp_node_attr_in *attrs;
-	void **ret_node;
+#define HEAP_POOL_LIMIT 0x400000
+
+struct pooled_heap {
+	struct pooled_heap *next;
+	size_t size;
 };
 
+/* the free heaps themselves hold the list; sizes are page aligned */
+static struct pooled_heap *heap_pool;
+static size_t heap_pool_limit = HEAP_POOL_LIMIT;
+static struct dsp_heap_stats heap_stats;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *get_heap(size_t size)
+{
+	struct pooled_heap **p, *h;
+	void *heap;
+
+	pthread_mutex_lock(&heap_lock);
+	for (p = &heap_pool; (h = *p); p = &h->next) {
+		if (h->size != size)
+			continue;
+		*p = h->next;
+		heap_stats.reused++;
+		heap_stats.pooled--;
+		heap_stats.pooled_bytes -= size;
+		pthread_mutex_unlock(&heap_lock);
+		return h;
+	}
+	heap_stats.allocated++;
+	pthread_mutex_unlock(&heap_lock);
+
+	heap = memalign(128, size);
+	if (!heap)
+		return NULL;
+
+	/* fault it in now rather than while the node runs */
+	memset(heap, 0, size);
+
+	return heap;
+}
+
+static void free_heap(void *heap,
+		size_t size)
+{
+	struct pooled_heap *h = heap;
+
+	if (!heap)
+		return;
+
+	pthread_mutex_lock(&heap_lock);
+	if (heap_stats.pooled_bytes + size > heap_pool_limit) {
+		heap_stats.released++;
+		pthread_mutex_unlock(&heap_lock);
+		free(heap);
+		return;
+	}
+	h->size = size;
+	h->next = heap_pool;
+	heap_pool = h;
+	heap_stats.pooled++;
+	heap_stats.pooled_bytes += size;
+	pthread_mutex_unlock(&heap_lock);
+}
+
+void dsp_heap_pool_get_stats(struct dsp_heap_stats *stats)
+{
+	pthread_mutex_lock(&heap_lock);
+	*stats = heap_stats;
+	pthread_mutex_unlock(&heap_lock);
+}
+
+void dsp_heap_pool_set_limit(size_t bytes)
+{
+	struct pooled_heap *h;
+
+	pthread_mutex_lock(&heap_lock);
+	heap_pool_limit = bytes;
+	while (heap_stats.pooled_bytes > heap_pool_limit && (h = heap_pool)) {
+		heap_pool = h->next;
+		heap_stats.pooled--;
+		heap_stats.pooled_bytes -= h->size;
+		heap_stats.released++;
+		free(h);
+	}
+	pthread_mutex_unlock(&heap_lock);
+}
+
+void dsp_heap_pool_flush(void)
+{
+	struct pooled_heap *h;
+
+	pthread_mutex_lock(&heap_lock);
+	h = heap_pool;
+	heap_pool = NULL;
+	heap_stats.pooled = 0;
+	heap_stats.pooled_bytes = 0;
+	pthread_mutex_unlock(&heap_lock);
+
+	while (h) {
+		struct pooled_heap *next = h->next;
+		free(h);
+		h = next;
+	}
+}
+#else
+static inline void free_heap(void *heap,
+		size_t size)
+{
+	free(heap);
+}
+#endif
+
 bool dsp_node_allocate(int handle,
 		void *proc_handle,
 		const struct dsp_uuid *node_uuid,
@@ -708,7 +1004,7 @@ bool dsp_node_allocate(int handle,
 				void *virtual = NULL;
 
 				heap_size = PG_ALIGN_HIGH(heap_size, PG_SIZE_4K);
-				virtual = memalign(128, heap_size);
+				virtual = get_heap(heap_size);
 				if (!virtual)
 					return false;
 				attrs->heap_size = heap_size;
@@ -720,7 +1016,7 @@ bool dsp_node_allocate(int handle,
 
 	if (ioctl(handle, NODE_ALLOCATE, &arg)) {
 		if (attrs) {
-			free(attrs->gpp_va);
+			free_heap(attrs->gpp_va, attrs->heap_size);
 			attrs->gpp_va = NULL;
 		}
 		return false;
@@ -728,13 +1024,15 @@ bool dsp_node_allocate(int handle,
 
 	node = calloc(1, sizeof(*node));
 	node->handle = node_handle;
-	if (attrs)
+	if (attrs) {
 		node->heap = attrs->gpp_va;
+		node->heap_size = attrs->heap_size;
+	}
 
 #ifdef ALLOCATE_SM
 	if (!allocate_segments(handle, proc_handle, node)) {
 		dsp_node_delete(handle, node);
-		free(node->heap);
+		free_heap(node->heap, node->heap_size);
 		free(node);
 		return false;
 	}
@@ -745,15 +1043,6 @@ bool dsp_node_allocate(int handle,
 	return true;
 }
 
-struct node_connect {
-	void *node_handle;
-	unsigned int stream;
-	void *other_node_handle;
-	unsigned int other_stream;
-	struct dsp_stream_attr *attrs;
-	void *params;
-};
-
 bool dsp_node_connect(int handle,
 		struct dsp_node *node,
 		unsigned int stream,
@@ -762,10 +1051,11 @@ bool dsp_node_connect(int handle,
 		struct dsp_stream_attr *attrs,
 		void *params)
 {
+	/* a NULL node is the GPP */
 	struct node_connect arg = {
-		.node_handle = node->handle,
+		.node_handle = node ? node->handle : DSP_HGPPNODE,
 		.stream = stream,
-		.other_node_handle = other_node->handle,
+		.other_node_handle = other_node ? other_node->handle : DSP_HGPPNODE,
 		.other_stream = other_stream,
 		.attrs = attrs,
 		.params = params,
@@ -778,21 +1068,16 @@ bool dsp_node_free(int handle,
 		struct dsp_node *node)
 {
 #ifdef ALLOCATE_SM
-	munmap(node->msgbuf_addr, node->msgbuf_size);
+	if (node->msgbuf_addr)
+		put_segment(handle, node->msgbuf_addr);
 #endif
 	dsp_node_delete(handle, node);
-	free(node->heap);
+	free_heap(node->heap, node->heap_size);
 	free(node);
 
 	return true;
 }
 
-struct reserve_mem {
-	void *proc_handle;
-	unsigned long size;
-	void **addr;
-};
-
 bool dsp_reserve(int handle,
 		void *proc_handle,
 		unsigned long size,
@@ -807,12 +1092,6 @@ bool dsp_reserve(int handle,
 	return !ioctl(handle, PROC_RSVMEM, &arg);
 }
 
-struct unreserve_mem {
-	void *proc_handle;
-	unsigned long size;
-	void *addr;
-};
-
 bool dsp_unreserve(int handle,
 		void *proc_handle,
 		void *addr)
@@ -825,15 +1104,6 @@ bool dsp_unreserve(int handle,
 	return !ioctl(handle, PROC_UNRSVMEM, &arg);
 }
 
-struct map_mem {
-	void *proc_handle;
-	void *mpu_addr;
-	unsigned long size;
-	void *req_addr;
-	void **ret_map_addr;
-	unsigned long attr;
-};
-
 bool dsp_map(int handle,
 		void *proc_handle,
 		void *mpu_addr,
@@ -854,12 +1124,6 @@ bool dsp_map(int handle,
 	return !ioctl(handle, PROC_MAPMEM, &arg);
 }
 
-struct unmap_mem {
-	void *proc_handle;
-	unsigned long size;
-	void *map_addr;
-};
-
 bool dsp_unmap(int handle,
 		void *proc_handle,
 		void *map_addr)
@@ -872,13 +1136,6 @@ bool dsp_unmap(int handle,
 	return !ioctl(handle, PROC_UNMAPMEM, &arg);
 }
 
-struct flush_mem {
-	void *proc_handle;
-	void *mpu_addr;
-	unsigned long size;
-	unsigned long flags;
-};
-
 bool dsp_flush(int handle,
 		void *proc_handle,
 		void *mpu_addr,
@@ -895,12 +1152,6 @@ bool dsp_flush(int handle,
 	return !ioctl(handle, PROC_FLUSHMEMORY, &arg);
 }
 
-struct invalidate_mem {
-	void *proc_handle;
-	void *mpu_addr;
-	unsigned long size;
-};
-
 bool dsp_invalidate(int handle,
 		void *proc_handle,
 		void *mpu_addr,
@@ -915,12 +1166,98 @@ bool dsp_invalidate(int handle,
 	return !ioctl(handle, PROC_INVALIDATEMEMORY, &arg);
 }
 
-struct proc_get_info {
-	void *proc_handle;
-	unsigned type;
-	struct dsp_info *info;
-	unsigned size;
-};
+static int range_cmp(const void *a,
+		const void *b)
+{
+	const struct dsp_range *ra = a, *rb = b;
+
+	if (ra->mpu_addr < rb->mpu_addr)
+		return -1;
+	return ra->mpu_addr > rb->mpu_addr;
+}
+
+#define LINE_ALIGN_LOW(addr) ((addr) & ~(CACHE_LINE_SIZE - 1UL))
+#define LINE_ALIGN_HIGH(addr) LINE_ALIGN_LOW((addr) + CACHE_LINE_SIZE - 1)
+
+static inline bool sync_range(int handle,
+		void *proc_handle,
+		void *mpu_addr,
+		unsigned long size,
+		bool flush,
+		unsigned long flags)
+{
+	if (flush)
+		return dsp_flush(handle, proc_handle, mpu_addr, size, flags);
+	return dsp_invalidate(handle, proc_handle, mpu_addr, size);
+}
+
+static bool sync_v(int handle,
+		void *proc_handle,
+		struct dsp_range *ranges,
+		unsigned int count,
+		bool flush,
+		unsigned long flags)
+{
+	unsigned int i = 0, j, k;
+	bool ret = true;
+
+	qsort(ranges, count, sizeof(*ranges), range_cmp);
+
+	while (i < count) {
+		unsigned long start, end;
+
+		if (!ranges[i].size) {
+			i++;
+			continue;
+		}
+
+		start = LINE_ALIGN_LOW((unsigned long) ranges[i].mpu_addr);
+		end = LINE_ALIGN_HIGH((unsigned long) ranges[i].mpu_addr + ranges[i].size);
+
+		for (j = i + 1; j < count; j++) {
+			unsigned long addr = (unsigned long) ranges[j].mpu_addr;
+
+			if (LINE_ALIGN_LOW(addr) > end)
+				break;
+			if (LINE_ALIGN_HIGH(addr + ranges[j].size) > end)
+				end = LINE_ALIGN_HIGH(addr + ranges[j].size);
+		}
+
+		if (!sync_range(handle, proc_handle, (void *) start, end - start, flush, flags)) {
+			/* the driver wants each range inside a single mapping */
+			if (j - i == 1)
+				ret = false;
+			for (k = i; j - i > 1 && k < j; k++) {
+				if (!ranges[k].size)
+					continue;
+				if (!sync_range(handle, proc_handle, ranges[k].mpu_addr,
+							ranges[k].size, flush, flags))
+					ret = false;
+			}
+		}
+
+		i = j;
+	}
+
+	return ret;
+}
+
+bool dsp_flush_v(int handle,
+		void *proc_handle,
+		struct dsp_range *ranges,
+		unsigned int count,
+		unsigned long flags)
+{
+	return sync_v(handle, proc_handle, ranges, count, true, flags);
+}
+
+bool dsp_invalidate_v(int handle,
+		void *proc_handle,
+		struct dsp_range *ranges,
+		unsigned int count)
+{
+	return sync_v(handle, proc_handle, ranges, count, false, 0);
+}
 
 bool dsp_proc_get_info(int handle,
 		void *proc_handle,
@@ -938,14 +1275,6 @@ bool dsp_proc_get_info(int handle,
 	return !ioctl(handle, PROC_ENUMRESOURCES, &arg);
 }
 
-struct enum_nodes {
-	void *proc_handle;
-	void **node_table;
-	unsigned node_table_size;
-	unsigned *num_nodes;
-	unsigned *allocated;
-};
-
 bool dsp_enum_nodes(int handle,
 		void *proc_handle,
 		void **node_table,
@@ -964,22 +1293,6 @@ bool dsp_enum_nodes(int handle,
 	return !ioctl(handle, PROC_ENUMNODE, &arg);
 }
 
-struct stream_attr {
-	void *event;
-	char *name;
-	void *base;
-	unsigned long size;
-	struct dsp_stream_attr_in *attrin;
-};
-
-struct stream_open {
-	void *node_handle;
-	unsigned int direction;
-	unsigned int index;
-	struct stream_attr *attr;
-	void *stream;
-};
-
 bool dsp_stream_open(int handle,
 		struct dsp_node *node,
 		unsigned int direction,
@@ -1000,88 +1313,62 @@ bool dsp_stream_open(int handle,
 
 	if (attrin && (attrin->mode == STRMMODE_ZEROCOPY ||
 				attrin->mode == STRMMODE_RDMA)) {
-		struct dsp_cmm_info cmm_info;
+		void *base;
+		size_t size;
 
-		if (!get_cmm_info(handle, NULL, &cmm_info))
+		if (!get_segment(handle, NULL, &base, &size))
 			return false;
 
-		if (cmm_info.segments > 0) {
-			void *base;
-			struct dsp_cmm_seg_info *seg;
-
-			seg = &cmm_info.info[0];
-			base = mmap(NULL, seg->size,
-					PROT_READ | PROT_WRITE,
-					MAP_SHARED | 0x2000 /* MAP_LOCKED */,
-					handle, seg->base_pa);
-
-			if (!base)
-				return false;
+		strm_attr.base = base;
+		strm_attr.size = base ? size : 0;
+	}
 
-			strm_attr.base = base;
-			strm_attr.size = seg->size;
-		}
+	if (ioctl(handle, STRM_OPEN, &stream_arg)) {
+		if (strm_attr.base)
+			put_segment(handle, strm_attr.base);
+		return false;
 	}
 
-	return !ioctl(handle, STRM_OPEN, &stream_arg);
+	return true;
 }
 
-struct stream_info {
-	enum dsp_stream_mode mode;
-	unsigned int segment;
-	void *base;
-	struct dsp_stream_info *info;
-};
-
-struct stream_get_info {
-	void *stream;
-	struct stream_info *info;
-	unsigned int size;
-};
-
 static inline bool get_stream_info(int handle,
 		void *stream,
 		struct stream_info *info,
 		unsigned int size)
 {
+	struct dsp_stream_info tmp;
 	struct stream_get_info arg = {
 		.stream = stream,
 		.info = info,
 		.size = size,
 	};
 
+	/* the driver always fills the user info */
+	if (!info->info) {
+		info->info = &tmp;
+		arg.size = sizeof(tmp);
+	}
+
 	return !ioctl(handle, STRM_GETINFO, &arg);
 }
 
 bool dsp_stream_close(int handle,
 		void *stream)
 {
-	struct stream_info info;
+	struct stream_info info = { .info = NULL };
 	if (!get_stream_info(handle, stream, &info, sizeof(struct stream_info)))
 		return false;
 
-	if (info.base) {
-		struct dsp_cmm_info cmm_info;
-
-		if (!get_cmm_info(handle, NULL, &cmm_info))
-			return false;
+	if (ioctl(handle, STRM_CLOSE, &stream))
+		return false;
 
-		if (cmm_info.segments > 0) {
-			struct dsp_cmm_seg_info *seg;
-			seg = &cmm_info.info[0];
-			if (munmap(info.base, seg->size))
-				return false;
-		}
-	}
+	if (info.base && !put_segment(handle, info.base))
+		return false;
 
-	return !ioctl(handle, STRM_CLOSE, &stream);
+	return true;
 }
 
-struct stream_idle {
-	void *stream;
-	bool flush;
-};
-
 bool dsp_stream_idle(int handle,
 		void *stream,
 		bool flush)
@@ -1093,14 +1380,6 @@ bool dsp_stream_idle(int handle,
 	return !ioctl(handle, STRM_IDLE, &arg);
 }
 
-struct stream_reclaim {
-	void *stream;
-	unsigned char **buff;
-	unsigned long *data_size;
-	unsigned long *buff_size;
-	unsigned long *flag;
-};
-
 bool dsp_stream_reclaim(int handle,
 		void *stream,
 		unsigned char **buff,
@@ -1118,14 +1397,6 @@ bool dsp_stream_reclaim(int handle,
 	return !ioctl(handle, STRM_RECLAIM, &arg);
 }
 
-struct stream_issue {
-	void *stream;
-	unsigned char *buff;
-	unsigned long data_size;
-	unsigned long buff_size;
-	unsigned long flag;
-};
-
 bool dsp_stream_issue(int handle,
 		void *stream,
 		unsigned char *buff,
@@ -1156,13 +1427,6 @@ bool dsp_stream_get_info(int handle,
 }
 
 
-struct stream_allocate_buffer {
-	void *stream;
-	unsigned int size;
-	unsigned char **buff;
-	unsigned int num_buf;
-};
-
 bool dsp_stream_allocate_buffers(int handle,
 		void *stream,
 		unsigned int size,
@@ -1170,7 +1434,7 @@ bool dsp_stream_allocate_buffers(int handle,
 		unsigned int num_buf)
 {
 	unsigned int i;
-	struct stream_info info;
+	struct stream_info info = { .info = NULL };
 	if (!get_stream_info(handle, stream, &info, sizeof(struct stream_info)))
 		return false;
 
@@ -1191,19 +1455,13 @@ bool dsp_stream_allocate_buffers(int handle,
 	return true;
 }
 
-struct stream_free_buffers {
-	void *stream;
-	unsigned char **buff;
-	unsigned int num_buf;
-};
-
 bool dsp_stream_free_buffers(int handle,
 		void *stream,
 		unsigned char **buff,
 		unsigned int num_buf)
 {
 	unsigned int i;
-	struct stream_info info;
+	struct stream_info info = { .info = NULL };
 	if (!get_stream_info(handle, stream, &info, sizeof(struct stream_info)))
 		return false;
 
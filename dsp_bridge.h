@@ -21,9 +21,20 @@
 #define DSP_SYSERROR 0x00000020
 #define DSP_NODEMESSAGEREADY 0x00000200
 
+#define DSP_SIGNALEVENT 0x00000002
+
+/* stream directions, as seen from the node */
+#define DSP_TONODE 1
+#define DSP_FROMNODE 2
+
+/* stands for the GPP in dsp_node_connect() */
+#define DSP_HGPPNODE ((void *) 0xffffffff)
+
 #define MAX_PROFILES 16
 #define DSP_MAXNAMELEN 32
 
+#define CACHE_LINE_SIZE 64
+
 struct dsp_uuid {
 	uint32_t field_1;
 	uint16_t field_2;
@@ -36,6 +47,7 @@ struct dsp_uuid {
 struct dsp_node {
 	void *handle;
 	void *heap;
+	size_t heap_size;
 	void *msgbuf_addr;
 	size_t msgbuf_size;
 };
@@ -47,6 +59,11 @@ struct dsp_msg {
 	uint32_t arg_2;
 };
 
+struct dsp_range {
+	void *mpu_addr;
+	unsigned long size;
+};
+
 struct dsp_notification {
 	char *name;
 	void *handle;
@@ -264,6 +281,20 @@ bool dsp_node_allocate(int handle,
 		struct dsp_node_attr_in *attrs,
 		struct dsp_node **ret_node);
 
+/*
+ * Carves a block out of the shared memory segment mapped for the node; it
+ * has to be given back with dsp_node_free_sm() while the node is around.
+ */
+bool dsp_node_alloc_sm(int handle,
+		struct dsp_node *node,
+		size_t size,
+		void **buffer,
+		uint32_t *dsp_addr);
+
+bool dsp_node_free_sm(int handle,
+		struct dsp_node *node,
+		void *buffer);
+
 bool dsp_node_free(int handle,
 		struct dsp_node *node);
 
@@ -327,6 +358,21 @@ bool dsp_invalidate(int handle,
 		void *mpu_addr,
 		unsigned long size);
 
+/*
+ * Ranges are sorted in place, then merged at cache line granularity so the
+ * minimum number of ioctls is issued.
+ */
+bool dsp_flush_v(int handle,
+		void *proc_handle,
+		struct dsp_range *ranges,
+		unsigned int count,
+		unsigned long flags);
+
+bool dsp_invalidate_v(int handle,
+		void *proc_handle,
+		struct dsp_range *ranges,
+		unsigned int count);
+
 bool dsp_register_notify(int handle,
 		void *proc_handle,
 		unsigned int event_mask,
@@ -438,4 +484,56 @@ bool dsp_stream_free_buffers(int handle,
 		unsigned char **buff,
 		unsigned int num_buf);
 
+#ifdef ALLOCATE_HEAP
+/*
+ * Node heaps are recycled instead of freed: a heap released by
+ * dsp_node_free() is kept for the next node allocated with a profile of the
+ * same size, already faulted in. The pool holds up to a limit of bytes;
+ * beyond it heaps are freed as before.
+ */
+
+struct dsp_heap_stats {
+	unsigned long allocated; /* fresh heaps */
+	unsigned long reused; /* taken from the pool */
+	unsigned long released; /* freed because the pool was full */
+	unsigned int pooled;
+	size_t pooled_bytes;
+};
+
+void dsp_heap_pool_get_stats(struct dsp_heap_stats *stats);
+
+void dsp_heap_pool_set_limit(size_t bytes);
+
+/* frees every pooled heap */
+void dsp_heap_pool_flush(void);
+#endif
+
+/*
+ * Per-ioctl statistics; every call through the bridge is timed and counted.
+ * The counters are kept per thread and only summed up here, so the cost on
+ * the calling side is two clock reads, one on each side of the ioctl, and a
+ * few non-atomic stores.
+ */
+
+#define DSP_STATS_BUCKETS 32
+
+struct dsp_ioctl_stats {
+	unsigned long request;
+	uint64_t count;
+	uint64_t errors;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	/* bucket n counts calls that took [2^n, 2^(n+1)) ns */
+	uint64_t histogram[DSP_STATS_BUCKETS];
+};
+
+/* fills up to 'count' entries, one per ioctl issued; returns how many */
+unsigned int dsp_bridge_get_stats(struct dsp_ioctl_stats *stats,
+		unsigned int count);
+
+void dsp_bridge_reset_stats(void);
+
+const char *dsp_ioctl_name(unsigned long request);
+
 #endif /* DSP_BRIDGE_H */
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "dsp_dcd_cache.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define RECORD_SIZE 512
+#define UUID_SIZE 37
+#define BOOT_ID_SIZE 40
+
+static void
+uuid_string(const struct dsp_uuid *uuid,
+		char *str)
+{
+	snprintf(str, UUID_SIZE, "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+			uuid->field_1, uuid->field_2, uuid->field_3,
+			uuid->field_4, uuid->field_5,
+			uuid->field_6[0], uuid->field_6[1], uuid->field_6[2],
+			uuid->field_6[3], uuid->field_6[4], uuid->field_6[5]);
+}
+
+/* registrations are gone after a reboot */
+static void
+get_boot_id(char *boot_id)
+{
+	FILE *f;
+
+	strcpy(boot_id, "-");
+
+	f = fopen("/proc/sys/kernel/random/boot_id", "r");
+	if (!f)
+		return;
+	if (fgets(boot_id, BOOT_ID_SIZE, f))
+		boot_id[strcspn(boot_id, "\n")] = '\0';
+	fclose(f);
+}
+
+/* one line per uuid; the path goes last as it might have spaces */
+static bool
+make_record(const char *uuid,
+		const char *path,
+		char *record)
+{
+	struct stat st;
+	char boot_id[BOOT_ID_SIZE];
+	int n;
+
+	if (stat(path, &st) < 0)
+		return false;
+
+	get_boot_id(boot_id);
+
+	n = snprintf(record, RECORD_SIZE, "%s %lu %ld.%09ld %lld %s %s\n",
+			uuid, (unsigned long) st.st_ino,
+			(long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec,
+			(long long) st.st_size, boot_id, path);
+
+	return n > 0 && n < RECORD_SIZE;
+}
+
+static bool
+find_record(const char *cache,
+		const char *record)
+{
+	FILE *f;
+	struct stat st;
+	char line[RECORD_SIZE];
+	bool found = false;
+
+	f = fopen(cache, "r");
+	if (!f)
+		return false;
+
+	/* a record someone else could have planted isn't trusted */
+	if (fstat(fileno(f), &st) < 0 || st.st_uid != geteuid() ||
+			(st.st_mode & (S_IWGRP | S_IWOTH))) {
+		pr_warning("ignoring %s, it's not private", cache);
+		fclose(f);
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (!strcmp(line, record)) {
+			found = true;
+			break;
+		}
+	}
+
+	fclose(f);
+	return found;
+}
+
+/*
+ * Replaces the line of the uuid; written aside and renamed, so readers never
+ * see half of it. The temporary file is created exclusively, next to the
+ * cache, so it can't be a link planted to clobber something else.
+ */
+static bool
+save_record(const char *cache,
+		const char *uuid,
+		const char *record)
+{
+	FILE *old, *f;
+	char tmp[PATH_MAX];
+	char line[RECORD_SIZE];
+	int fd;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", cache) >= (int) sizeof(tmp))
+		return false;
+
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return false;
+
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp);
+		return false;
+	}
+
+	old = fopen(cache, "r");
+	if (old) {
+		while (fgets(line, sizeof(line), old))
+			if (strncmp(line, uuid, UUID_SIZE - 1))
+				fputs(line, f);
+		fclose(old);
+	}
+
+	fputs(record, f);
+
+	if (fclose(f) || rename(tmp, cache) < 0) {
+		unlink(tmp);
+		return false;
+	}
+
+	return true;
+}
+
+const char *dsp_dcd_cache_path(void)
+{
+	static char path[PATH_MAX];
+	const char *cache = getenv("DSP_DCD_CACHE");
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+
+	if (cache && *cache)
+		return cache;
+
+	if (!dir || !*dir)
+		return DSP_DCD_CACHE_DEFAULT;
+
+	snprintf(path, sizeof(path), "%s/dsp_dcd_cache", dir);
+	return path;
+}
+
+bool dsp_register_cached(int handle,
+		const struct dsp_uuid *uuid,
+		const char *path,
+		bool force,
+		bool *registered)
+{
+	const char *cache = dsp_dcd_cache_path();
+	char uuid_str[UUID_SIZE];
+	char record[RECORD_SIZE];
+	bool have_record;
+
+	if (registered)
+		*registered = false;
+
+	uuid_string(uuid, uuid_str);
+	have_record = make_record(uuid_str, path, record);
+
+	if (have_record && !force && find_record(cache, record)) {
+		pr_debug("%s already registered", path);
+		return true;
+	}
+
+	if (!dsp_register(handle, uuid, DSP_DCD_LIBRARYTYPE, path))
+		return false;
+
+	if (!dsp_register(handle, uuid, DSP_DCD_NODETYPE, path))
+		return false;
+
+	if (registered)
+		*registered = true;
+
+	/* without a record it's simply registered every time */
+	if (have_record && !save_record(cache, uuid_str, record))
+		pr_warning("failed to update %s", cache);
+
+	return true;
+}
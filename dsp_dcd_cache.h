@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef DSP_DCD_CACHE_H
+#define DSP_DCD_CACHE_H
+
+#include <stdbool.h>
+
+#include "dsp_bridge.h"
+
+/*
+ * DCD registrations outlive the process that made them, so there is no need
+ * to register a node library again on every start. A record of what was
+ * registered (uuid, path, and the file's inode, mtime and size, plus the
+ * boot id) is kept in a small file, and the library and node are only
+ * registered when it doesn't match.
+ *
+ * The record can't tell when the bridge driver was reloaded; if allocating
+ * the node fails, call again with 'force' set.
+ */
+
+#define DSP_DCD_CACHE_DEFAULT "/var/run/dsp_dcd_cache"
+
+/*
+ * The cache file is taken from $DSP_DCD_CACHE, or dsp_dcd_cache in
+ * $XDG_RUNTIME_DIR, or the default; records in a file that isn't owned by
+ * the user, or that others can write, are ignored.
+ */
+const char *dsp_dcd_cache_path(void);
+
+/* registers 'path' as both the library and the node of 'uuid' */
+bool dsp_register_cached(int handle,
+		const struct dsp_uuid *uuid,
+		const char *path,
+		bool force,
+		bool *registered);
+
+#endif /* DSP_DCD_CACHE_H */
@@ -0,0 +1,1989 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "dsp_emu.h"
+#include "dsp_ioctl.h"
+#include "node.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <errno.h>
+#include <stdio.h> /* for sprintf, sscanf */
+#include <string.h> /* for memcmp, memset */
+#include <time.h> /* for clock_gettime */
+#include <unistd.h> /* for close, ftruncate */
+#include <sys/mman.h> /* for mmap, memfd_create */
+
+#define EMU_PAGE_SIZE 0x1000
+#define EMU_PAGE_ALIGN_LOW(addr) ((addr) & ~(EMU_PAGE_SIZE - 1UL))
+#define EMU_PAGE_ALIGN_HIGH(addr) EMU_PAGE_ALIGN_LOW((addr) + EMU_PAGE_SIZE - 1)
+
+/* DSP virtual space handed out by PROC_RSVMEM */
+#define EMU_DMM_BASE 0x20000000UL
+#define EMU_DMM_SIZE 0x10000000UL
+
+/* CMM segment 0; the physical address is an offset into the handle */
+#define EMU_SM_PA 0x01000000UL
+#define EMU_SM_DSP_VA 0x11000000UL
+#define EMU_SM_SIZE 0x00100000UL
+#define EMU_SM_ALIGN(num) (((num) + 127UL) & ~127UL)
+
+#define RMS_EXIT 0x80000000
+
+/* the node's properties; the Makefile passes the ones of dummy_bridge.s */
+#ifndef NODE_PRIORITY
+#define NODE_PRIORITY 1
+#endif
+#ifndef NODE_STACK_SIZE
+#define NODE_STACK_SIZE 1024
+#endif
+#ifndef NODE_MESSAGE_DEPTH
+#define NODE_MESSAGE_DEPTH 3
+#endif
+#ifndef NODE_INPUT_STREAMS
+#define NODE_INPUT_STREAMS 1
+#endif
+#ifndef NODE_OUTPUT_STREAMS
+#define NODE_OUTPUT_STREAMS 1
+#endif
+#ifndef NODE_TIMEOUT
+#define NODE_TIMEOUT 1000
+#endif
+#ifndef NODE_PROFILES
+#define NODE_PROFILES 0
+#endif
+
+#define EMU_MAX_STREAMS 16
+#define MEMRY_SETVIRTUALSEGID 0x10000000
+
+/* node phases, as they would be found by the dynamic loader */
+unsigned int dummy_create(int arg_length, char *arg_data,
+		int num_in_streams, RMS_WORD in_stream_def[],
+		int num_out_streams, RMS_WORD out_stream_def[],
+		void *env);
+unsigned int dummy_execute(void *env);
+unsigned int dummy_delete(void *env);
+
+struct emu_node_def {
+	struct dsp_uuid uuid;
+	const char *name;
+	int priority;
+	unsigned int stack_size;
+	unsigned int message_depth;
+	unsigned int num_input_streams;
+	unsigned int num_output_streams;
+	unsigned int timeout;
+	unsigned int heap_sizes[MAX_PROFILES];
+	unsigned int (*create)(int arg_length, char *arg_data,
+			int num_in_streams, RMS_WORD in_stream_def[],
+			int num_out_streams, RMS_WORD out_stream_def[],
+			void *env);
+	unsigned int (*execute)(void *env);
+	unsigned int (*delete)(void *env);
+};
+
+static const struct emu_node_def node_defs[] = {
+	{
+		.uuid = { 0x3dac26d0, 0x6d4b, 0x11dd, 0xad, 0x8b,
+			{ 0x08, 0x00, 0x20, 0x0c, 0x9a, 0x66 } },
+		.name = "dummy",
+		.priority = NODE_PRIORITY,
+		.stack_size = NODE_STACK_SIZE,
+		.message_depth = NODE_MESSAGE_DEPTH,
+		.num_input_streams = NODE_INPUT_STREAMS,
+		.num_output_streams = NODE_OUTPUT_STREAMS,
+		.timeout = NODE_TIMEOUT,
+		.heap_sizes = { NODE_PROFILES },
+		.create = dummy_create,
+		.execute = dummy_execute,
+		.delete = dummy_delete,
+	},
+};
+
+struct emu_object {
+	struct emu_object *next;
+	struct dsp_uuid uuid;
+	enum dsp_dcd_object_type type;
+};
+
+struct emu_queue {
+	struct dsp_msg *msgs;
+	unsigned int depth;
+	unsigned int head;
+	unsigned int count;
+	pthread_cond_t cond;
+};
+
+struct emu_notify {
+	struct emu_notify *next;
+	bool signaled;
+};
+
+struct emu_node {
+	struct emu_node *next;
+	const struct emu_node_def *def;
+	enum dsp_node_state state;
+	struct emu_queue to_dsp;
+	struct emu_queue to_gpp;
+	pthread_t thread;
+	unsigned int exit_status;
+	void *heap;
+	unsigned int heap_size;
+	void *sm_base;
+	struct emu_notify *notify;
+};
+
+/* a piece of the shared memory segment, freed along with its owner */
+struct emu_sm_block {
+	struct emu_sm_block *next;
+	unsigned long offset;
+	unsigned long size;
+	void *owner;
+};
+
+struct emu_range {
+	struct emu_range *next;
+	unsigned long dsp_addr;
+	unsigned long size;
+	void *mpu_addr;
+};
+
+struct emu_frame {
+	unsigned char *buff;
+	unsigned long data_size;
+	unsigned long buff_size;
+	unsigned long arg;
+};
+
+struct emu_frame_queue {
+	struct emu_frame *frames;
+	unsigned int head;
+	unsigned int count;
+};
+
+struct emu_pipe;
+
+struct emu_stream {
+	struct emu_stream *next;
+	struct emu_pipe *pipe;
+	struct emu_node *node;
+	unsigned int direction;
+	unsigned int index;
+	enum dsp_stream_mode mode;
+	unsigned int segment;
+	unsigned int num_bufs;
+	unsigned int timeout;
+	void *base;
+	unsigned long num_bytes;
+	struct emu_frame_queue issued;
+	struct emu_frame_queue done;
+	/* taken by the node with SIO_reclaim() */
+	struct emu_frame *held;
+	unsigned int nr_held;
+	pthread_cond_t cond;
+};
+
+/* a stream connected between a node and the GPP */
+struct emu_pipe {
+	struct emu_pipe *next;
+	unsigned int id;
+	struct emu_node *node;
+	unsigned int direction;
+	unsigned int index;
+	RMS_StrmDef *def;
+	struct emu_stream *stream;
+	/* the node waits here */
+	pthread_cond_t cond;
+};
+
+static struct {
+	int fd;
+	pthread_mutex_t lock;
+	struct emu_object *objects;
+	struct emu_node *nodes;
+	struct emu_range *reserved;
+	struct emu_range *mapped;
+	struct emu_stream *streams;
+	struct emu_notify *notifies;
+	struct emu_pipe *pipes;
+	unsigned int pipe_id;
+	pthread_cond_t events;
+	void *sm;
+	/* sorted by offset */
+	struct emu_sm_block *sm_blocks;
+} emu = {
+	.fd = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * DSP_EMU_FAIL=NAME[:N] makes the Nth call of that ioctl fail, or every one
+ * without N, so the error paths can be exercised.
+ */
+static struct {
+	char name[32];
+	unsigned long nth;
+	unsigned long calls;
+} emu_fail;
+
+static void
+fail_init(void)
+{
+	const char *env = getenv("DSP_EMU_FAIL");
+	char *p;
+
+	memset(&emu_fail, 0, sizeof(emu_fail));
+	if (!env)
+		return;
+
+	snprintf(emu_fail.name, sizeof(emu_fail.name), "%s", env);
+	p = strchr(emu_fail.name, ':');
+	if (p) {
+		*p++ = '\0';
+		emu_fail.nth = strtoul(p, NULL, 0);
+	}
+}
+
+static bool
+fail_request(unsigned long request)
+{
+	if (!emu_fail.name[0] || strcmp(dsp_ioctl_name(request), emu_fail.name))
+		return false;
+
+	emu_fail.calls++;
+	return !emu_fail.nth || emu_fail.calls == emu_fail.nth;
+}
+
+static inline bool
+uuid_equal(const struct dsp_uuid *a,
+		const struct dsp_uuid *b)
+{
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+static void
+cond_init(pthread_cond_t *cond)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static void
+deadline_init(struct timespec *ts,
+		unsigned int timeout)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += timeout / 1000;
+	ts->tv_nsec += (timeout % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/* called with emu.lock held; timeout in ms, -1 waits forever */
+static int
+cond_wait(pthread_cond_t *cond,
+		unsigned int timeout,
+		const struct timespec *deadline)
+{
+	if (timeout == 0)
+		return ETIME;
+	if (timeout == (unsigned int) -1)
+		return pthread_cond_wait(cond, &emu.lock);
+	if (pthread_cond_timedwait(cond, &emu.lock, deadline) == ETIMEDOUT)
+		return ETIME;
+	return 0;
+}
+
+static int
+queue_put(struct emu_queue *q,
+		const struct dsp_msg *msg,
+		unsigned int timeout)
+{
+	struct timespec deadline;
+
+	deadline_init(&deadline, timeout);
+	while (q->count == q->depth) {
+		int err = cond_wait(&q->cond, timeout, &deadline);
+		if (err)
+			return err;
+	}
+
+	q->msgs[(q->head + q->count) % q->depth] = *msg;
+	q->count++;
+	pthread_cond_broadcast(&q->cond);
+
+	return 0;
+}
+
+static int
+queue_get(struct emu_queue *q,
+		struct dsp_msg *msg,
+		unsigned int timeout)
+{
+	struct timespec deadline;
+
+	deadline_init(&deadline, timeout);
+	while (q->count == 0) {
+		int err = cond_wait(&q->cond, timeout, &deadline);
+		if (err)
+			return err;
+	}
+
+	*msg = q->msgs[q->head];
+	q->head = (q->head + 1) % q->depth;
+	q->count--;
+	pthread_cond_broadcast(&q->cond);
+
+	return 0;
+}
+
+static void
+queue_init(struct emu_queue *q,
+		unsigned int depth)
+{
+	q->msgs = calloc(depth, sizeof(*q->msgs));
+	q->depth = depth;
+	cond_init(&q->cond);
+}
+
+static void
+queue_deinit(struct emu_queue *q)
+{
+	pthread_cond_destroy(&q->cond);
+	free(q->msgs);
+}
+
+static bool
+frame_push(struct emu_frame_queue *q,
+		unsigned int size,
+		const struct emu_frame *frame)
+{
+	if (q->count == size)
+		return false;
+	q->frames[(q->head + q->count) % size] = *frame;
+	q->count++;
+	return true;
+}
+
+static bool
+frame_pop(struct emu_frame_queue *q,
+		unsigned int size,
+		struct emu_frame *frame)
+{
+	if (q->count == 0)
+		return false;
+	*frame = q->frames[q->head];
+	q->head = (q->head + 1) % size;
+	q->count--;
+	return true;
+}
+
+static const struct emu_node_def *
+find_def(const struct dsp_uuid *uuid)
+{
+	struct emu_object *o;
+	unsigned int i;
+
+	for (o = emu.objects; o; o = o->next)
+		if (o->type == DSP_DCD_NODETYPE && uuid_equal(&o->uuid, uuid))
+			break;
+	if (!o)
+		return NULL;
+
+	for (i = 0; i < sizeof(node_defs) / sizeof(*node_defs); i++)
+		if (uuid_equal(&node_defs[i].uuid, uuid))
+			return &node_defs[i];
+
+	return NULL;
+}
+
+static void
+fill_props(const struct emu_node_def *def,
+		struct dsp_ndb_props *props)
+{
+	unsigned int i;
+
+	memset(props, 0, sizeof(*props));
+	props->cb_struct = sizeof(*props);
+	props->node_id = def->uuid;
+	strncpy(props->ac_name, def->name, DSP_MAXNAMELEN - 1);
+	props->ntype = DSP_NODE_TASK;
+	props->prio = def->priority;
+	props->stack_size = def->stack_size;
+	props->sys_stack_size = 16;
+	props->message_depth = def->message_depth;
+	props->num_input_streams = def->num_input_streams;
+	props->num_output_streams = def->num_output_streams;
+	props->timeout = def->timeout;
+	props->count_profiles = MAX_PROFILES;
+	for (i = 0; i < MAX_PROFILES; i++)
+		props->node_profiles[i].heap_size = def->heap_sizes[i];
+}
+
+static struct emu_node *
+find_node(void *handle)
+{
+	struct emu_node *node;
+
+	for (node = emu.nodes; node; node = node->next)
+		if (node == handle)
+			return node;
+
+	return NULL;
+}
+
+static struct emu_stream *
+find_stream(void *handle)
+{
+	struct emu_stream *s;
+
+	for (s = emu.streams; s; s = s->next)
+		if (s == handle)
+			return s;
+
+	return NULL;
+}
+
+static struct emu_pipe *
+find_pipe(struct emu_node *node,
+		unsigned int direction,
+		unsigned int index)
+{
+	struct emu_pipe *p;
+
+	for (p = emu.pipes; p; p = p->next)
+		if (p->node == node && p->direction == direction && p->index == index)
+			return p;
+
+	return NULL;
+}
+
+/* first fit; returns the offset in the segment, or -1 */
+static long
+sm_alloc(unsigned long size,
+		void *owner)
+{
+	struct emu_sm_block **p, *b;
+	unsigned long offset = 0;
+
+	size = EMU_SM_ALIGN(size);
+
+	for (p = &emu.sm_blocks; *p; p = &(*p)->next) {
+		if ((*p)->offset - offset >= size)
+			break;
+		offset = (*p)->offset + (*p)->size;
+	}
+
+	if (offset + size > EMU_SM_SIZE)
+		return -1;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return -1;
+	b->offset = offset;
+	b->size = size;
+	b->owner = owner;
+	b->next = *p;
+	*p = b;
+
+	return offset;
+}
+
+static bool
+sm_free(unsigned long offset)
+{
+	struct emu_sm_block **p;
+
+	for (p = &emu.sm_blocks; *p; p = &(*p)->next) {
+		struct emu_sm_block *b = *p;
+
+		if (b->offset == offset) {
+			*p = b->next;
+			free(b);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* whatever the node or stream didn't give back */
+static void
+sm_free_owner(void *owner)
+{
+	struct emu_sm_block **p;
+
+	for (p = &emu.sm_blocks; *p; ) {
+		struct emu_sm_block *b = *p;
+
+		if (owner && b->owner != owner) {
+			p = &b->next;
+			continue;
+		}
+		*p = b->next;
+		free(b);
+	}
+}
+
+static void
+stream_free(struct emu_stream *s)
+{
+	sm_free_owner(s);
+	if (s->pipe)
+		s->pipe->stream = NULL;
+	free(s->issued.frames);
+	free(s->done.frames);
+	free(s->held);
+	pthread_cond_destroy(&s->cond);
+	free(s);
+}
+
+static struct emu_notify *
+find_notify(void *handle)
+{
+	struct emu_notify *n;
+
+	for (n = emu.notifies; n; n = n->next)
+		if (n == handle)
+			return n;
+
+	return NULL;
+}
+
+static void
+remove_notify(struct emu_notify *notify)
+{
+	struct emu_notify **p;
+
+	for (p = &emu.notifies; *p; p = &(*p)->next) {
+		if (*p == notify) {
+			*p = notify->next;
+			free(notify);
+			return;
+		}
+	}
+}
+
+static struct emu_range *
+find_range(struct emu_range *list,
+		unsigned long dsp_addr)
+{
+	for (; list; list = list->next)
+		if (dsp_addr >= list->dsp_addr && dsp_addr < list->dsp_addr + list->size)
+			return list;
+
+	return NULL;
+}
+
+static void
+remove_range(struct emu_range **list,
+		struct emu_range *range)
+{
+	struct emu_range **p;
+
+	for (p = list; *p; p = &(*p)->next) {
+		if (*p == range) {
+			*p = range->next;
+			free(range);
+			return;
+		}
+	}
+}
+
+static bool
+range_is_mapped(void *mpu_addr,
+		unsigned long size)
+{
+	struct emu_range *m;
+	char *start = mpu_addr;
+
+	for (m = emu.mapped; m; m = m->next) {
+		char *base = m->mpu_addr;
+		if (start >= base && start + size <= base + m->size)
+			return true;
+	}
+
+	return false;
+}
+
+/* MGR */
+
+static int
+emu_register(struct register_object *arg)
+{
+	struct emu_object *o;
+
+	for (o = emu.objects; o; o = o->next)
+		if (o->type == arg->type && uuid_equal(&o->uuid, arg->uuid))
+			return 0;
+
+	o = calloc(1, sizeof(*o));
+	o->uuid = *arg->uuid;
+	o->type = arg->type;
+	o->next = emu.objects;
+	emu.objects = o;
+
+	return 0;
+}
+
+static int
+emu_unregister(struct unregister_object *arg)
+{
+	struct emu_object **p;
+
+	for (p = &emu.objects; *p; p = &(*p)->next) {
+		struct emu_object *o = *p;
+		if (o->type == arg->type && uuid_equal(&o->uuid, arg->uuid)) {
+			*p = o->next;
+			free(o);
+			return 0;
+		}
+	}
+
+	return ENOENT;
+}
+
+static int
+emu_enum(struct enum_node *arg)
+{
+	struct emu_object *o;
+	const struct emu_node_def *def = NULL;
+	unsigned int count = 0;
+
+	for (o = emu.objects; o; o = o->next) {
+		if (o->type != DSP_DCD_NODETYPE)
+			continue;
+		if (count++ == arg->num)
+			def = find_def(&o->uuid);
+	}
+
+	*arg->ret_num = count;
+	if (!def)
+		return ENODATA;
+	if (arg->info_size < sizeof(struct dsp_ndb_props))
+		return EINVAL;
+
+	fill_props(def, arg->info);
+
+	return 0;
+}
+
+static int
+emu_wait(struct wait_for_events *arg)
+{
+	struct timespec deadline;
+
+	deadline_init(&deadline, arg->timeout);
+	while (true) {
+		unsigned int i;
+		int err;
+
+		for (i = 0; i < arg->count; i++) {
+			struct emu_notify *n = find_notify(arg->notifications[i]->handle);
+			if (n && n->signaled) {
+				n->signaled = false;
+				*arg->ret_index = i;
+				return 0;
+			}
+		}
+
+		err = cond_wait(&emu.events, arg->timeout, &deadline);
+		if (err)
+			return err;
+	}
+}
+
+/* PROC */
+
+static int
+emu_reserve(struct reserve_mem *arg)
+{
+	struct emu_range *r, **p;
+	unsigned long size, addr = EMU_DMM_BASE;
+
+	size = EMU_PAGE_ALIGN_HIGH(arg->size);
+	if (!size)
+		return EINVAL;
+
+	/* first fit; the list is kept sorted */
+	for (p = &emu.reserved; *p; p = &(*p)->next) {
+		if ((*p)->dsp_addr - addr >= size)
+			break;
+		addr = (*p)->dsp_addr + (*p)->size;
+	}
+
+	if (addr + size > EMU_DMM_BASE + EMU_DMM_SIZE)
+		return ENOMEM;
+
+	r = calloc(1, sizeof(*r));
+	r->dsp_addr = addr;
+	r->size = size;
+	r->next = *p;
+	*p = r;
+
+	*arg->addr = (void *) addr;
+
+	return 0;
+}
+
+static int
+emu_unreserve(struct unreserve_mem *arg)
+{
+	struct emu_range *r;
+
+	r = find_range(emu.reserved, (unsigned long) arg->addr);
+	if (!r || r->dsp_addr != (unsigned long) arg->addr)
+		return EINVAL;
+
+	remove_range(&emu.reserved, r);
+
+	return 0;
+}
+
+/*
+ * Entries the DSP MMU would need, picking the largest page that both sides
+ * are aligned to like the bridge does; there are no physical addresses here,
+ * so the MPU address stands in for one.
+ */
+static void
+count_mmu_entries(unsigned long va,
+		unsigned long pa,
+		unsigned long size,
+		unsigned int entries[3])
+{
+	static const unsigned long sizes[] = { 0x100000, 0x10000, EMU_PAGE_SIZE };
+	unsigned int i;
+
+	while (size) {
+		for (i = 0; i < 2; i++) {
+			if (!((va | pa) & (sizes[i] - 1)) && size >= sizes[i])
+				break;
+		}
+		entries[i]++;
+		va += sizes[i];
+		pa += sizes[i];
+		size -= sizes[i];
+	}
+}
+
+static int
+emu_map(struct map_mem *arg)
+{
+	struct emu_range *r, *m;
+	unsigned long va_align, pa_align, size_align;
+	unsigned int entries[3] = { 0 };
+
+	va_align = EMU_PAGE_ALIGN_LOW((unsigned long) arg->req_addr);
+	pa_align = EMU_PAGE_ALIGN_LOW((unsigned long) arg->mpu_addr);
+	size_align = EMU_PAGE_ALIGN_HIGH(arg->size + (unsigned long) arg->mpu_addr - pa_align);
+
+	r = find_range(emu.reserved, va_align);
+	if (!r || va_align + size_align > r->dsp_addr + r->size)
+		return EINVAL;
+
+	if (find_range(emu.mapped, va_align))
+		return EADDRINUSE;
+
+	m = calloc(1, sizeof(*m));
+	m->dsp_addr = va_align;
+	m->size = size_align;
+	m->mpu_addr = (void *) pa_align;
+	m->next = emu.mapped;
+	emu.mapped = m;
+
+	count_mmu_entries(va_align, pa_align, size_align, entries);
+	pr_debug("%#lx: %lu bytes in %u 1M, %u 64K and %u 4K entries",
+			va_align, size_align, entries[0], entries[1], entries[2]);
+
+	*arg->ret_map_addr = (void *) (va_align + (unsigned long) arg->mpu_addr - pa_align);
+
+	return 0;
+}
+
+static int
+emu_unmap(struct unmap_mem *arg)
+{
+	struct emu_range *m;
+	unsigned long va_align;
+
+	va_align = EMU_PAGE_ALIGN_LOW((unsigned long) arg->map_addr);
+	m = find_range(emu.mapped, va_align);
+	if (!m || m->dsp_addr != va_align)
+		return EINVAL;
+
+	remove_range(&emu.mapped, m);
+
+	return 0;
+}
+
+static int
+emu_get_info(struct proc_get_info *arg)
+{
+	struct dsp_info *info = arg->info;
+	struct emu_range *r;
+	unsigned long addr = EMU_DMM_BASE, free_size = 0, max_free = 0;
+
+	if (arg->size < sizeof(*info))
+		return EINVAL;
+
+	memset(info, 0, sizeof(*info));
+	info->cb = sizeof(*info);
+	info->type = arg->type;
+
+	if (arg->type == DSP_RESOURCE_PROCLOAD)
+		return 0;
+
+	for (r = emu.reserved; ; r = r->next) {
+		unsigned long end = r ? r->dsp_addr : EMU_DMM_BASE + EMU_DMM_SIZE;
+		unsigned long hole = end - addr;
+
+		if (hole) {
+			free_size += hole;
+			info->result.mem.free_blocks++;
+			if (hole > max_free)
+				max_free = hole;
+		}
+		if (!r)
+			break;
+		info->result.mem.alloc_blocks++;
+		addr = r->dsp_addr + r->size;
+	}
+
+	info->result.mem.size = EMU_DMM_SIZE;
+	info->result.mem.total_free_size = free_size;
+	info->result.mem.len_max_free_block = max_free;
+
+	return 0;
+}
+
+static int
+emu_enum_nodes(struct enum_nodes *arg)
+{
+	struct emu_node *node;
+	unsigned int count = 0;
+
+	for (node = emu.nodes; node; node = node->next) {
+		if (count < arg->node_table_size)
+			arg->node_table[count] = node;
+		count++;
+	}
+
+	*arg->num_nodes = count < arg->node_table_size ? count : arg->node_table_size;
+	*arg->allocated = count;
+
+	return 0;
+}
+
+/* NODE */
+
+static int
+emu_node_allocate(struct node_allocate *arg)
+{
+	const struct emu_node_def *def;
+	struct emu_node *node;
+
+	def = find_def(arg->node_id);
+	if (!def)
+		return ENOENT;
+
+	node = calloc(1, sizeof(*node));
+	node->def = def;
+	node->state = NODE_ALLOCATED;
+	queue_init(&node->to_dsp, def->message_depth);
+	queue_init(&node->to_gpp, def->message_depth);
+	if (arg->attrs) {
+		node->heap = arg->attrs->gpp_va;
+		node->heap_size = arg->attrs->heap_size;
+	}
+
+	node->next = emu.nodes;
+	emu.nodes = node;
+
+	*arg->ret_node = node;
+
+	return 0;
+}
+
+static int
+emu_node_get_attr(struct node_get_attr *arg)
+{
+	struct emu_node *node;
+	struct dsp_node_attr *attr = arg->attr;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+	if (arg->attr_size < sizeof(*attr))
+		return EINVAL;
+
+	memset(attr, 0, sizeof(*attr));
+	attr->cb = sizeof(*attr);
+	attr->attr_in.heap_size = node->heap_size;
+	attr->attr_in.gpp_va = node->heap;
+	attr->inputs = node->def->num_input_streams;
+	attr->outputs = node->def->num_output_streams;
+	attr->info.cb = sizeof(attr->info);
+	fill_props(node->def, &attr->info.props);
+	attr->info.priority = attr->info.props.prio;
+	attr->info.state = node->state;
+
+	return 0;
+}
+
+static int
+emu_node_alloc_buf(struct node_alloc_buf *arg)
+{
+	struct emu_node *node;
+	long offset;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+
+	if (arg->attr && (arg->attr->segment & MEMRY_SETVIRTUALSEGID)) {
+		node->sm_base = *arg->buffer;
+		return 0;
+	}
+
+	offset = sm_alloc(arg->size, node);
+	if (offset < 0)
+		return ENOMEM;
+
+	*arg->buffer = (char *) (node->sm_base ? node->sm_base : emu.sm) + offset;
+
+	return 0;
+}
+
+static int
+emu_node_free_buf(struct node_free_buf *arg)
+{
+	struct emu_node *node;
+	char *base;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+
+	base = node->sm_base ? node->sm_base : emu.sm;
+	if (!sm_free((char *) arg->buffer - base))
+		return EINVAL;
+
+	return 0;
+}
+
+static int
+emu_node_create(struct node_create *arg)
+{
+	struct emu_node *node;
+	RMS_WORD in_defs[EMU_MAX_STREAMS], out_defs[EMU_MAX_STREAMS];
+	unsigned int num_in, num_out;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+	if (node->state != NODE_ALLOCATED)
+		return EPERM;
+
+	for (num_in = 0; num_in < node->def->num_input_streams; num_in++) {
+		struct emu_pipe *p = find_pipe(node, DSP_TONODE, num_in);
+		if (!p)
+			break;
+		in_defs[num_in] = (RMS_WORD) p->def;
+	}
+
+	for (num_out = 0; num_out < node->def->num_output_streams; num_out++) {
+		struct emu_pipe *p = find_pipe(node, DSP_FROMNODE, num_out);
+		if (!p)
+			break;
+		out_defs[num_out] = (RMS_WORD) p->def;
+	}
+
+	/* the create phase may call SIO_create() */
+	pthread_mutex_unlock(&emu.lock);
+	node->def->create(0, NULL, num_in, in_defs, num_out, out_defs, node);
+	pthread_mutex_lock(&emu.lock);
+	node->state = NODE_CREATED;
+
+	return 0;
+}
+
+static void *
+node_thread(void *data)
+{
+	struct emu_node *node = data;
+
+	node->exit_status = node->def->execute(node);
+
+	return NULL;
+}
+
+static int
+emu_node_run(struct node_run *arg)
+{
+	struct emu_node *node;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+	if (node->state != NODE_CREATED)
+		return EPERM;
+
+	if (pthread_create(&node->thread, NULL, node_thread, node))
+		return EAGAIN;
+	node->state = NODE_RUNNING;
+
+	return 0;
+}
+
+static int
+node_terminate(struct emu_node *node)
+{
+	const struct dsp_msg msg = { .cmd = RMS_EXIT };
+	pthread_t thread = node->thread;
+	int err;
+
+	err = queue_put(&node->to_dsp, &msg, (unsigned int) -1);
+	if (err)
+		return err;
+
+	node->state = NODE_DONE;
+
+	pthread_mutex_unlock(&emu.lock);
+	pthread_join(thread, NULL);
+	pthread_mutex_lock(&emu.lock);
+
+	return 0;
+}
+
+static int
+emu_node_terminate(struct node_terminate *arg)
+{
+	struct emu_node *node;
+	int err;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+	if (node->state != NODE_RUNNING)
+		return EPERM;
+
+	err = node_terminate(node);
+	if (err)
+		return err;
+
+	*arg->status = node->exit_status;
+
+	return 0;
+}
+
+static void
+node_delete(struct emu_node *node)
+{
+	struct emu_node **p;
+	struct emu_stream **s;
+	struct emu_pipe **pp;
+
+	if (node->state == NODE_RUNNING)
+		node_terminate(node);
+	if (node->state != NODE_ALLOCATED)
+		node->def->delete(node);
+
+	for (s = &emu.streams; *s; ) {
+		struct emu_stream *stream = *s;
+		if (stream->node == node) {
+			*s = stream->next;
+			stream_free(stream);
+		} else
+			s = &stream->next;
+	}
+
+	for (pp = &emu.pipes; *pp; ) {
+		struct emu_pipe *pipe = *pp;
+		if (pipe->node == node) {
+			*pp = pipe->next;
+			pthread_cond_destroy(&pipe->cond);
+			free(pipe->def);
+			free(pipe);
+		} else
+			pp = &pipe->next;
+	}
+
+	for (p = &emu.nodes; *p; p = &(*p)->next) {
+		if (*p == node) {
+			*p = node->next;
+			break;
+		}
+	}
+
+	if (node->notify)
+		remove_notify(node->notify);
+	sm_free_owner(node);
+	queue_deinit(&node->to_dsp);
+	queue_deinit(&node->to_gpp);
+	free(node);
+}
+
+static int
+emu_node_delete(struct node_delete *arg)
+{
+	struct emu_node *node;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+
+	node_delete(node);
+
+	return 0;
+}
+
+static int
+emu_node_put_message(struct node_put_message *arg)
+{
+	struct emu_node *node;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+	if (node->state != NODE_RUNNING && node->state != NODE_CREATED)
+		return EPERM;
+
+	return queue_put(&node->to_dsp, arg->message, arg->timeout);
+}
+
+static int
+emu_node_get_message(struct node_get_message *arg)
+{
+	struct emu_node *node;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+
+	return queue_get(&node->to_gpp, arg->message, arg->timeout);
+}
+
+static int
+emu_node_connect(struct node_connect *arg)
+{
+	struct emu_node *node;
+	struct emu_pipe *pipe;
+	unsigned int direction, index, count;
+	const struct dsp_stream_attr *attrs = arg->attrs;
+
+	if (arg->node_handle == DSP_HGPPNODE) {
+		node = find_node(arg->other_node_handle);
+		direction = DSP_TONODE;
+		index = arg->other_stream;
+	} else if (arg->other_node_handle == DSP_HGPPNODE) {
+		node = find_node(arg->node_handle);
+		direction = DSP_FROMNODE;
+		index = arg->stream;
+	} else {
+		pr_warning("only connections to the GPP are supported");
+		return ENOSYS;
+	}
+
+	if (!node)
+		return EFAULT;
+	if (node->state != NODE_ALLOCATED)
+		return EPERM;
+
+	count = direction == DSP_TONODE ?
+		node->def->num_input_streams : node->def->num_output_streams;
+	if (index >= count || index >= EMU_MAX_STREAMS)
+		return EINVAL;
+	if (find_pipe(node, direction, index))
+		return EBUSY;
+
+	pipe = calloc(1, sizeof(*pipe));
+	pipe->def = calloc(1, sizeof(*pipe->def) + 16);
+	pipe->id = emu.pipe_id++;
+	pipe->node = node;
+	pipe->direction = direction;
+	pipe->index = index;
+	cond_init(&pipe->cond);
+
+	pipe->def->nbufs = 1;
+	pipe->def->timeout = (unsigned int) -1;
+	if (attrs) {
+		pipe->def->bufsize = attrs->buf_size;
+		if (attrs->num_bufs)
+			pipe->def->nbufs = attrs->num_bufs;
+		pipe->def->segid = attrs->seg_id;
+		pipe->def->align = attrs->alignment;
+		pipe->def->timeout = attrs->timeout;
+	}
+	sprintf(pipe->def->name, "/dbpipe%u", pipe->id);
+
+	pipe->next = emu.pipes;
+	emu.pipes = pipe;
+
+	return 0;
+}
+
+static int
+emu_node_register_notify(struct node_register_notify *arg)
+{
+	struct emu_node *node;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+
+	if (!(arg->event_mask & DSP_NODEMESSAGEREADY)) {
+		if (node->notify)
+			remove_notify(node->notify);
+		node->notify = NULL;
+		arg->info->handle = NULL;
+		return 0;
+	}
+
+	if (!node->notify) {
+		node->notify = calloc(1, sizeof(*node->notify));
+		node->notify->next = emu.notifies;
+		emu.notifies = node->notify;
+	}
+	node->notify->signaled = node->to_gpp.count > 0;
+	arg->info->handle = node->notify;
+
+	return 0;
+}
+
+static int
+emu_get_uuid_props(struct get_uuid_props *arg)
+{
+	const struct emu_node_def *def;
+
+	def = find_def(arg->node_uuid);
+	if (!def)
+		return ENOENT;
+
+	fill_props(def, arg->props);
+
+	return 0;
+}
+
+/* CMM */
+
+static int
+emu_cmm_get_info(struct cmm_get_info *arg)
+{
+	struct dsp_cmm_info *info = arg->info;
+	struct dsp_cmm_seg_info *seg = &info->info[0];
+
+	memset(info, 0, sizeof(*info));
+	info->segments = 1;
+	info->use_count = 1;
+	info->min_block_size = 128;
+
+	seg->base_pa = EMU_SM_PA;
+	seg->size = EMU_SM_SIZE;
+	seg->gpp_base_pa = EMU_SM_PA;
+	seg->gpp_size = EMU_SM_SIZE;
+	seg->dsp_base_va = EMU_SM_DSP_VA;
+	seg->dsp_size = EMU_SM_SIZE;
+	seg->use_count = 1;
+	seg->base_va = (unsigned long) emu.sm;
+
+	return 0;
+}
+
+/* STRM */
+
+static int
+emu_stream_open(struct stream_open *arg)
+{
+	struct emu_node *node;
+	struct emu_stream *s;
+	struct emu_pipe *pipe;
+	struct dsp_stream_attr_in *attrin = arg->attr ? arg->attr->attrin : NULL;
+
+	node = find_node(arg->node_handle);
+	if (!node)
+		return EFAULT;
+
+	/* has to be connected with the GPP first */
+	pipe = find_pipe(node, arg->direction, arg->index);
+	if (!pipe)
+		return EPERM;
+	if (pipe->stream)
+		return EBUSY;
+
+	s = calloc(1, sizeof(*s));
+	s->node = node;
+	s->pipe = pipe;
+	s->direction = arg->direction;
+	s->index = arg->index;
+	s->num_bufs = 1;
+	s->timeout = (unsigned int) -1;
+	if (attrin) {
+		s->mode = attrin->mode;
+		s->segment = attrin->segment;
+		s->timeout = attrin->timeout;
+		if (attrin->num_bufs)
+			s->num_bufs = attrin->num_bufs;
+	}
+	if (arg->attr)
+		s->base = arg->attr->base;
+	s->issued.frames = calloc(s->num_bufs, sizeof(struct emu_frame));
+	s->done.frames = calloc(s->num_bufs, sizeof(struct emu_frame));
+	s->held = calloc(s->num_bufs, sizeof(struct emu_frame));
+	cond_init(&s->cond);
+
+	s->next = emu.streams;
+	emu.streams = s;
+
+	pipe->stream = s;
+	pthread_cond_broadcast(&pipe->cond);
+
+	*(void **) arg->stream = s;
+
+	return 0;
+}
+
+static int
+emu_stream_close(void **arg)
+{
+	struct emu_stream *s, **p;
+
+	s = find_stream(*arg);
+	if (!s)
+		return EFAULT;
+	if (s->issued.count || s->done.count || s->nr_held)
+		return EPIPE;
+
+	for (p = &emu.streams; *p; p = &(*p)->next) {
+		if (*p == s) {
+			*p = s->next;
+			break;
+		}
+	}
+
+	pthread_cond_broadcast(&s->pipe->cond);
+	stream_free(s);
+
+	return 0;
+}
+
+static int
+emu_stream_get_info(struct stream_get_info *arg)
+{
+	struct emu_stream *s;
+	struct stream_info *info = arg->info;
+
+	s = find_stream(arg->stream);
+	if (!s)
+		return EFAULT;
+
+	info->mode = s->mode;
+	info->segment = s->segment;
+	info->base = s->base;
+	if (info->info) {
+		struct dsp_stream_info *i = info->info;
+
+		i->cb = sizeof(*i);
+		i->num_bufs_allowed = s->num_bufs;
+		i->num_bufs_in_stream = s->issued.count + s->done.count + s->nr_held;
+		i->num_bytes = s->num_bytes;
+		i->sync_handle = NULL;
+		if (s->done.count)
+			i->state = STREAM_DONE;
+		else if (s->issued.count || s->nr_held)
+			i->state = STREAM_PENDING;
+		else
+			i->state = STREAM_IDLE;
+	}
+
+	return 0;
+}
+
+static int
+emu_stream_idle(struct stream_idle *arg)
+{
+	struct emu_stream *s;
+	struct emu_frame frame;
+
+	s = find_stream(arg->stream);
+	if (!s)
+		return EFAULT;
+
+	if (!arg->flush) {
+		while (s->issued.count || s->nr_held)
+			pthread_cond_wait(&s->cond, &emu.lock);
+		return 0;
+	}
+
+	while (frame_pop(&s->issued, s->num_bufs, &frame)) {
+		frame.data_size = 0;
+		frame_push(&s->done, s->num_bufs, &frame);
+	}
+	pthread_cond_broadcast(&s->cond);
+
+	return 0;
+}
+
+static int
+emu_stream_issue(struct stream_issue *arg)
+{
+	struct emu_stream *s;
+	struct emu_frame frame = {
+		.buff = arg->buff,
+		.data_size = arg->data_size,
+		.buff_size = arg->buff_size,
+		.arg = arg->flag,
+	};
+
+	s = find_stream(arg->stream);
+	if (!s)
+		return EFAULT;
+	if (s->issued.count + s->done.count + s->nr_held >= s->num_bufs)
+		return ENOSR;
+
+	frame_push(&s->issued, s->num_bufs, &frame);
+	pthread_cond_broadcast(&s->cond);
+	if (s->pipe)
+		pthread_cond_broadcast(&s->pipe->cond);
+
+	return 0;
+}
+
+static int
+emu_stream_reclaim(struct stream_reclaim *arg)
+{
+	struct emu_stream *s;
+	struct emu_frame frame;
+	struct timespec deadline;
+
+	s = find_stream(arg->stream);
+	if (!s)
+		return EFAULT;
+
+	deadline_init(&deadline, s->timeout);
+	while (!frame_pop(&s->done, s->num_bufs, &frame)) {
+		int err;
+		if (!s->issued.count && !s->nr_held)
+			return EPERM;
+		err = cond_wait(&s->cond, s->timeout, &deadline);
+		if (err)
+			return err;
+	}
+	pthread_cond_broadcast(&s->cond);
+
+	*arg->buff = frame.buff;
+	*arg->data_size = frame.data_size;
+	if (arg->buff_size)
+		*arg->buff_size = frame.buff_size;
+	if (arg->flag)
+		*arg->flag = frame.arg;
+
+	return 0;
+}
+
+static int
+emu_stream_allocate_buffers(struct stream_allocate_buffer *arg)
+{
+	struct emu_stream *s;
+	unsigned int i;
+
+	s = find_stream(arg->stream);
+	if (!s)
+		return EFAULT;
+
+	for (i = 0; i < arg->num_buf; i++) {
+		long offset = sm_alloc(arg->size, s);
+
+		if (offset < 0) {
+			while (i--)
+				sm_free(arg->buff[i] - (unsigned char *) (s->base ? s->base : emu.sm));
+			return ENOMEM;
+		}
+		arg->buff[i] = (unsigned char *) (s->base ? s->base : emu.sm) + offset;
+	}
+
+	return 0;
+}
+
+static int
+emu_stream_free_buffers(struct stream_free_buffers *arg)
+{
+	struct emu_stream *s;
+	unsigned int i;
+
+	s = find_stream(arg->stream);
+	if (!s)
+		return EFAULT;
+
+	for (i = 0; i < arg->num_buf; i++) {
+		unsigned char *base = s->base ? s->base : emu.sm;
+
+		if (arg->buff[i])
+			sm_free(arg->buff[i] - base);
+		arg->buff[i] = NULL;
+	}
+
+	return 0;
+}
+
+int
+dsp_emu_ioctl(int handle,
+		unsigned long request,
+		void *arg)
+{
+	int err = 0;
+
+	pthread_mutex_lock(&emu.lock);
+
+	if (fail_request(request)) {
+		pr_warning("failing %s", dsp_ioctl_name(request));
+		pthread_mutex_unlock(&emu.lock);
+		errno = EIO;
+		return -1;
+	}
+
+	switch (request) {
+	case MGR_REGISTEROBJECT:
+		err = emu_register(arg);
+		break;
+	case MGR_UNREGISTEROBJECT:
+		err = emu_unregister(arg);
+		break;
+	case MGR_ENUMNODE_INFO:
+		err = emu_enum(arg);
+		break;
+	case MGR_WAIT:
+		err = emu_wait(arg);
+		break;
+	case PROC_ATTACH:
+		if (((struct proc_attach *) arg)->num != 0)
+			err = ENODEV;
+		else
+			*((struct proc_attach *) arg)->ret_handle = &emu;
+		break;
+	case PROC_DETACH:
+	case PROC_REGISTERNOTIFY:
+	case PROC_START:
+	case PROC_STOP:
+	case PROC_LOAD:
+		break;
+	case PROC_RSVMEM:
+		err = emu_reserve(arg);
+		break;
+	case PROC_UNRSVMEM:
+		err = emu_unreserve(arg);
+		break;
+	case PROC_MAPMEM:
+		err = emu_map(arg);
+		break;
+	case PROC_UNMAPMEM:
+		err = emu_unmap(arg);
+		break;
+	case PROC_FLUSHMEMORY: {
+		struct flush_mem *flush = arg;
+		if (!range_is_mapped(flush->mpu_addr, flush->size))
+			err = EFAULT;
+		break;
+	}
+	case PROC_INVALIDATEMEMORY: {
+		struct invalidate_mem *inv = arg;
+		if (!range_is_mapped(inv->mpu_addr, inv->size))
+			err = EFAULT;
+		break;
+	}
+	case PROC_ENUMRESOURCES:
+		err = emu_get_info(arg);
+		break;
+	case PROC_ENUMNODE:
+		err = emu_enum_nodes(arg);
+		break;
+	case NODE_ALLOCATE:
+		err = emu_node_allocate(arg);
+		break;
+	case NODE_GETATTR:
+		err = emu_node_get_attr(arg);
+		break;
+	case NODE_ALLOCMSGBUF:
+		err = emu_node_alloc_buf(arg);
+		break;
+	case NODE_FREEMSGBUF:
+		err = emu_node_free_buf(arg);
+		break;
+	case NODE_CREATE:
+		err = emu_node_create(arg);
+		break;
+	case NODE_RUN:
+		err = emu_node_run(arg);
+		break;
+	case NODE_TERMINATE:
+		err = emu_node_terminate(arg);
+		break;
+	case NODE_DELETE:
+		err = emu_node_delete(arg);
+		break;
+	case NODE_PUTMESSAGE:
+		err = emu_node_put_message(arg);
+		break;
+	case NODE_GETMESSAGE:
+		err = emu_node_get_message(arg);
+		break;
+	case NODE_GETUUIDPROPS:
+		err = emu_get_uuid_props(arg);
+		break;
+	case NODE_REGISTERNOTIFY:
+		err = emu_node_register_notify(arg);
+		break;
+	case NODE_CONNECT:
+		err = emu_node_connect(arg);
+		break;
+	case CMM_GETHANDLE:
+		*((struct cmm_get_handle *) arg)->cmm = (struct cmm_object *) &emu;
+		break;
+	case CMM_GETINFO:
+		err = emu_cmm_get_info(arg);
+		break;
+	case STRM_OPEN:
+		err = emu_stream_open(arg);
+		break;
+	case STRM_CLOSE:
+		err = emu_stream_close(arg);
+		break;
+	case STRM_GETINFO:
+		err = emu_stream_get_info(arg);
+		break;
+	case STRM_IDLE:
+		err = emu_stream_idle(arg);
+		break;
+	case STRM_ISSUE:
+		err = emu_stream_issue(arg);
+		break;
+	case STRM_RECLAIM:
+		err = emu_stream_reclaim(arg);
+		break;
+	case STRM_ALLOCATEBUFFER:
+		err = emu_stream_allocate_buffers(arg);
+		break;
+	case STRM_FREEBUFFER:
+		err = emu_stream_free_buffers(arg);
+		break;
+	default:
+		pr_warning("unsupported ioctl: %lx", request);
+		err = ENOSYS;
+		break;
+	}
+
+	pthread_mutex_unlock(&emu.lock);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+dsp_emu_open(void)
+{
+	int fd;
+
+	if (emu.fd >= 0) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	fd = memfd_create("DspBridge", MFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* the shared memory segment lives at EMU_SM_PA in the handle */
+	if (ftruncate(fd, EMU_SM_PA + EMU_SM_SIZE) < 0)
+		goto fail;
+
+	emu.sm = mmap(NULL, EMU_SM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, EMU_SM_PA);
+	if (emu.sm == MAP_FAILED)
+		goto fail;
+
+	emu.sm_blocks = NULL;
+	fail_init();
+	cond_init(&emu.events);
+	emu.fd = fd;
+
+	return fd;
+
+fail:
+	close(fd);
+	return -1;
+}
+
+int
+dsp_emu_close(int handle)
+{
+	pthread_mutex_lock(&emu.lock);
+
+	while (emu.nodes)
+		node_delete(emu.nodes);
+
+	while (emu.mapped)
+		remove_range(&emu.mapped, emu.mapped);
+	while (emu.reserved)
+		remove_range(&emu.reserved, emu.reserved);
+
+	while (emu.objects) {
+		struct emu_object *o = emu.objects;
+		emu.objects = o->next;
+		free(o);
+	}
+
+	sm_free_owner(NULL);
+
+	pthread_cond_destroy(&emu.events);
+	munmap(emu.sm, EMU_SM_SIZE);
+	emu.sm = NULL;
+	emu.fd = -1;
+
+	pthread_mutex_unlock(&emu.lock);
+
+	return close(handle);
+}
+
+bool
+dsp_emu_handle(int handle)
+{
+	return handle >= 0 && handle == emu.fd;
+}
+
+/* DSP side */
+
+unsigned short
+NODE_getMsg(void *env,
+		dsp_msg_t *msg,
+		unsigned int timeout)
+{
+	struct emu_node *node = env;
+	struct dsp_msg tmp;
+	int err;
+
+	pthread_mutex_lock(&emu.lock);
+	err = queue_get(&node->to_dsp, &tmp, timeout);
+	pthread_mutex_unlock(&emu.lock);
+
+	if (err)
+		return 0;
+
+	msg->cmd = tmp.cmd;
+	msg->arg_1 = tmp.arg_1;
+	msg->arg_2 = tmp.arg_2;
+
+	return 1;
+}
+
+unsigned short
+NODE_putMsg(void *env,
+		void *dest,
+		dsp_msg_t *msg,
+		unsigned int timeout)
+{
+	struct emu_node *node = env;
+	struct dsp_msg tmp = {
+		.cmd = msg->cmd,
+		.arg_1 = msg->arg_1,
+		.arg_2 = msg->arg_2,
+	};
+	int err;
+
+	pthread_mutex_lock(&emu.lock);
+	err = queue_put(&node->to_gpp, &tmp, timeout);
+	if (!err && node->notify) {
+		node->notify->signaled = true;
+		pthread_cond_broadcast(&emu.events);
+	}
+	pthread_mutex_unlock(&emu.lock);
+
+	return !err;
+}
+
+SIO_Attrs SIO_ATTRS = {
+	.nbufs = 2,
+	.model = SIO_STANDARD,
+	.timeout = (unsigned int) -1,
+};
+
+/* where the node sees a buffer the GPP issued */
+static void *
+frame_addr(struct emu_stream *s,
+		const struct emu_frame *frame)
+{
+	unsigned char *base = s->base;
+
+	if (base && frame->buff >= base && frame->buff < base + EMU_SM_SIZE)
+		return (char *) emu.sm + (frame->buff - base);
+	return frame->buff;
+}
+
+SIO_Handle
+SIO_create(char *name,
+		int mode,
+		unsigned int bufsize,
+		SIO_Attrs *attrs)
+{
+	struct emu_pipe *p;
+	unsigned int id;
+
+	if (sscanf(name, "/dbpipe%u", &id) != 1)
+		return NULL;
+
+	pthread_mutex_lock(&emu.lock);
+	for (p = emu.pipes; p; p = p->next)
+		if (p->id == id)
+			break;
+	pthread_mutex_unlock(&emu.lock);
+
+	if (!p)
+		return NULL;
+	if ((mode == SIO_INPUT) != (p->direction == DSP_TONODE)) {
+		pr_err("wrong mode for %s", name);
+		return NULL;
+	}
+
+	return (SIO_Handle) p;
+}
+
+int
+SIO_delete(SIO_Handle stream)
+{
+	/* the pipe goes away with the node */
+	return 0;
+}
+
+/* only the issue/reclaim model, with the buffers coming from the GPP */
+int
+SIO_reclaim(SIO_Handle stream,
+		void **buf,
+		uintptr_t *arg)
+{
+	struct emu_pipe *pipe = (struct emu_pipe *) stream;
+	struct emu_stream *s;
+	struct emu_frame frame;
+	int size;
+
+	pthread_mutex_lock(&emu.lock);
+	while (true) {
+		s = pipe->stream;
+		if (!s) {
+			pthread_mutex_unlock(&emu.lock);
+			return -1;
+		}
+		if (frame_pop(&s->issued, s->num_bufs, &frame))
+			break;
+		pthread_cond_wait(&pipe->cond, &emu.lock);
+	}
+
+	s->held[s->nr_held++] = frame;
+	*buf = frame_addr(s, &frame);
+	if (arg)
+		*arg = frame.arg;
+	/* filled input, or room for output */
+	size = pipe->direction == DSP_TONODE ? frame.data_size : frame.buff_size;
+	pthread_mutex_unlock(&emu.lock);
+
+	return size;
+}
+
+int
+SIO_issue(SIO_Handle stream,
+		void *buf,
+		unsigned int nbytes,
+		uintptr_t arg)
+{
+	struct emu_pipe *pipe = (struct emu_pipe *) stream;
+	struct emu_stream *s;
+	struct emu_frame frame;
+	unsigned int i;
+
+	pthread_mutex_lock(&emu.lock);
+	s = pipe->stream;
+	if (!s)
+		goto fail;
+
+	for (i = 0; i < s->nr_held; i++)
+		if (frame_addr(s, &s->held[i]) == buf)
+			break;
+	if (i == s->nr_held)
+		goto fail;
+
+	frame = s->held[i];
+	s->held[i] = s->held[--s->nr_held];
+	frame.data_size = nbytes;
+	frame.arg = arg;
+	frame_push(&s->done, s->num_bufs, &frame);
+	s->num_bytes += nbytes;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&emu.lock);
+
+	return 0;
+
+fail:
+	pthread_mutex_unlock(&emu.lock);
+	return -1;
+}
+
+/* the host is cache coherent; only order the accesses */
+
+void
+BCACHE_inv(void *ptr,
+		size_t size,
+		unsigned short wait)
+{
+	__sync_synchronize();
+}
+
+void
+BCACHE_wb(void *ptr,
+		size_t size,
+		unsigned short wait)
+{
+	__sync_synchronize();
+}
+
+void
+BCACHE_wbInv(void *ptr,
+		size_t size,
+		unsigned short wait)
+{
+	__sync_synchronize();
+}
+
+void *
+dsp_emu_addr(uint32_t addr)
+{
+	struct emu_range *m;
+	void *ptr = NULL;
+
+	pthread_mutex_lock(&emu.lock);
+
+	if (addr >= EMU_SM_DSP_VA && addr < EMU_SM_DSP_VA + EMU_SM_SIZE)
+		ptr = (char *) emu.sm + (addr - EMU_SM_DSP_VA);
+	else if ((m = find_range(emu.mapped, addr)))
+		ptr = (char *) m->mpu_addr + (addr - m->dsp_addr);
+
+	pthread_mutex_unlock(&emu.lock);
+
+	if (!ptr)
+		pr_err("bad dsp address: %x", addr);
+
+	return ptr;
+}
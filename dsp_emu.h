@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef DSP_EMU_H
+#define DSP_EMU_H
+
+#include <stdbool.h>
+
+/*
+ * In-process replacement for /dev/DspBridge; the DSP side of the nodes runs
+ * on host threads. Selected by dsp_open() when DSP_EMULATOR is set in the
+ * environment.
+ */
+
+int dsp_emu_open(void);
+
+int dsp_emu_close(int handle);
+
+bool dsp_emu_handle(int handle);
+
+int dsp_emu_ioctl(int handle,
+		unsigned long request,
+		void *arg);
+
+#endif /* DSP_EMU_H */
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2009-2010 Felipe Contreras
+ * Copyright (C) 2009-2010 Nokia Corporation
+ * Copyright (C) 2007 Texas Instruments, Incorporated
+ *
+ * Author: Felipe Contreras <felipe.contreras@gmail.com>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+/*
+ * The userspace side of the tidspbridge ioctl ABI; shared between the
+ * wrappers in dsp_bridge.c and the in-process emulator in dsp_emu.c.
+ */
+
+#ifndef DSP_IOCTL_H
+#define DSP_IOCTL_H
+
+#include "dsp_bridge.h"
+
+/*
+ * Dspbridge ioctl numbering scheme
+ *
+ *    7                           0
+ *  ---------------------------------
+ *  |  Module   |   ioctl Number    |
+ *  ---------------------------------
+ *  | x | x | x | 0 | 0 | 0 | 0 | 0 |
+ *  ---------------------------------
+ */
+
+/* ioctl driver identifier */
+#define DB 0xDB
+
+/*
+ * Following are used to distinguish between module ioctls, this is needed
+ * in case new ioctls are introduced.
+ */
+#define DB_MODULE_MASK 0xE0
+#define DB_IOC_MASK    0x1F
+
+#if DSP_API >= 1
+
+#include <linux/ioctl.h>
+
+/* ioctl module masks */
+#define DB_MGR  0x0
+#define DB_PROC 0x20
+#define DB_NODE 0x40
+#define DB_STRM 0x60
+#define DB_CMM  0x80
+
+/* Used to calculate the ioctl per dspbridge module */
+#define DB_IOC(module, num) \
+	(((module) & DB_MODULE_MASK) | ((num) & DB_IOC_MASK))
+
+#else
+
+#define DB_MGR  1
+#define DB_PROC 7
+#define DB_NODE 24
+#define DB_STRM 39
+#define DB_CMM  50
+
+#define DB_IOC(module, num)	((module) + (num))
+
+#undef _IOR
+#undef _IOW
+#undef _IOWR
+
+#define _IOR(type, nr, size)	(nr)
+#define _IOW(type, nr, size)	(nr)
+#define _IOWR(type, nr, size)	(nr)
+
+#endif /* DSP_API */
+
+/* MGR Module */
+#define MGR_WAIT		_IOWR(DB, DB_IOC(DB_MGR, 4), unsigned long)
+#define MGR_ENUMNODE_INFO	_IOWR(DB, DB_IOC(DB_MGR, 0), unsigned long)
+#define MGR_REGISTEROBJECT	_IOWR(DB, DB_IOC(DB_MGR, 2), unsigned long)
+#define MGR_UNREGISTEROBJECT	_IOWR(DB, DB_IOC(DB_MGR, 3), unsigned long)
+
+/* PROC Module */
+#define PROC_ATTACH		_IOWR(DB, DB_IOC(DB_PROC, 0), unsigned long)
+/* PROC_DETACH Deprecated */
+#define PROC_DETACH		_IOR(DB, DB_IOC(DB_PROC, 2), unsigned long)
+#define PROC_REGISTERNOTIFY	_IOWR(DB, DB_IOC(DB_PROC, 8), unsigned long)
+#define PROC_RSVMEM		_IOWR(DB, DB_IOC(DB_PROC, 10), unsigned long)
+#define PROC_UNRSVMEM		_IOW(DB, DB_IOC(DB_PROC, 11), unsigned long)
+#define PROC_MAPMEM		_IOWR(DB, DB_IOC(DB_PROC, 12), unsigned long)
+#define PROC_UNMAPMEM		_IOR(DB, DB_IOC(DB_PROC, 13), unsigned long)
+#define PROC_FLUSHMEMORY	_IOW(DB, DB_IOC(DB_PROC, 14), unsigned long)
+#define PROC_INVALIDATEMEMORY	_IOW(DB, DB_IOC(DB_PROC, 16), unsigned long)
+#define PROC_GET_STATE		_IOWR(DB, DB_IOC(DB_PROC, 5), unsigned long)
+#define PROC_ENUMRESOURCES	_IOWR(DB, DB_IOC(DB_PROC, 4), unsigned long)
+#define PROC_ENUMNODE		_IOWR(DB, DB_IOC(DB_PROC, 3), unsigned long)
+#define PROC_STOP               _IOWR(DB, DB_IOC(DB_PROC, 15), unsigned long)
+#define PROC_LOAD               _IOW(DB, DB_IOC(DB_PROC, 7), unsigned long)
+#define PROC_START              _IOW(DB, DB_IOC(DB_PROC, 9), unsigned long)
+
+/* NODE Module */
+#define NODE_REGISTERNOTIFY	_IOWR(DB, DB_IOC(DB_NODE, 11), unsigned long)
+#define NODE_CREATE		_IOW(DB, DB_IOC(DB_NODE, 4), unsigned long)
+#define NODE_RUN		_IOW(DB, DB_IOC(DB_NODE, 12), unsigned long)
+#define NODE_TERMINATE		_IOWR(DB, DB_IOC(DB_NODE, 13), unsigned long)
+#define NODE_PUTMESSAGE		_IOW(DB, DB_IOC(DB_NODE, 10), unsigned long)
+#define NODE_GETMESSAGE		_IOWR(DB, DB_IOC(DB_NODE, 8), unsigned long)
+#define NODE_DELETE		_IOW(DB, DB_IOC(DB_NODE, 5), unsigned long)
+#define NODE_GETATTR		_IOWR(DB, DB_IOC(DB_NODE, 7), unsigned long)
+#define NODE_ALLOCMSGBUF	_IOWR(DB, DB_IOC(DB_NODE, 1), unsigned long)
+#define NODE_FREEMSGBUF		_IOW(DB, DB_IOC(DB_NODE, 6), unsigned long)
+#define NODE_GETUUIDPROPS	_IOWR(DB, DB_IOC(DB_NODE, 14), unsigned long)
+#define NODE_ALLOCATE		_IOWR(DB, DB_IOC(DB_NODE, 0), unsigned long)
+#define NODE_CONNECT		_IOW(DB, DB_IOC(DB_NODE, 3), unsigned long)
+
+/* CMM Module */
+#define CMM_GETHANDLE		_IOR(DB, DB_IOC(DB_CMM, 2), unsigned long)
+#define CMM_GETINFO		_IOR(DB, DB_IOC(DB_CMM, 3), unsigned long)
+
+/* STRM Module */
+#define STRM_OPEN		_IOWR(DB, DB_IOC(DB_STRM, 7), unsigned long)
+#define STRM_CLOSE		_IOW(DB, DB_IOC(DB_STRM, 1), unsigned long)
+#define STRM_GETINFO		_IOWR(DB, DB_IOC(DB_STRM, 4), unsigned long)
+#define STRM_ALLOCATEBUFFER	_IOWR(DB, DB_IOC(DB_STRM, 0), unsigned long)
+#define STRM_IDLE		_IOW(DB, DB_IOC(DB_STRM, 5), unsigned long)
+#define STRM_RECLAIM		_IOWR(DB, DB_IOC(DB_STRM, 8), unsigned long)
+#define STRM_FREEBUFFER		_IOWR(DB, DB_IOC(DB_STRM, 2), unsigned long)
+#define STRM_ISSUE		_IOW(DB, DB_IOC(DB_STRM, 6), unsigned long)
+
+struct proc_attach {
+	unsigned int num;
+	const void *info; /* not used */
+	void **ret_handle;
+};
+
+struct proc_detach {
+	void *proc_handle;
+};
+
+struct register_notify {
+	void *proc_handle;
+	unsigned int event_mask;
+	unsigned int notify_type;
+	struct dsp_notification *info;
+};
+
+struct proc_start {
+	void *proc_handle;
+};
+
+struct proc_load {
+	void *proc_handle;
+	int argc;
+	char **argv;
+	char **env;
+};
+
+struct node_register_notify {
+	void *node_handle;
+	unsigned int event_mask;
+	unsigned int notify_type;
+	struct dsp_notification *info;
+};
+
+struct wait_for_events {
+	struct dsp_notification **notifications;
+	unsigned int count;
+	unsigned int *ret_index;
+	unsigned int timeout;
+};
+
+struct enum_node {
+	unsigned int num;
+	struct dsp_ndb_props *info;
+	unsigned int info_size;
+	unsigned int *ret_num;
+};
+
+struct register_object {
+	const struct dsp_uuid *uuid;
+	enum dsp_dcd_object_type type;
+	const char *path;
+};
+
+struct unregister_object {
+	const struct dsp_uuid *uuid;
+	enum dsp_dcd_object_type type;
+};
+
+struct node_create {
+	void *node_handle;
+};
+
+struct node_run {
+	void *node_handle;
+};
+
+struct node_terminate {
+	void *node_handle;
+	unsigned long *status;
+};
+
+struct node_put_message {
+	void *node_handle;
+	const struct dsp_msg *message;
+	unsigned int timeout;
+};
+
+struct node_get_message {
+	void *node_handle;
+	struct dsp_msg *message;
+	unsigned int timeout;
+};
+
+struct node_delete {
+	void *node_handle;
+};
+
+struct node_get_attr {
+	void *node_handle;
+	struct dsp_node_attr *attr;
+	unsigned int attr_size;
+};
+
+struct dsp_buffer_attr {
+	unsigned long cb;
+	unsigned int segment;
+	unsigned int alignment;
+};
+
+struct node_alloc_buf {
+	void *node_handle;
+	unsigned int size;
+	struct dsp_buffer_attr *attr;
+	void **buffer;
+};
+
+struct node_free_buf {
+	void *node_handle;
+	void *buffer;
+	struct dsp_buffer_attr *attr;
+};
+
+struct dsp_cmm_seg_info {
+	unsigned long base_pa;
+	unsigned long size;
+	unsigned long gpp_base_pa;
+	unsigned long gpp_size;
+	unsigned long dsp_base_va;
+	unsigned long dsp_size;
+	unsigned long use_count;
+	unsigned long base_va;
+};
+
+struct dsp_cmm_info {
+	unsigned long segments;
+	unsigned long use_count;
+	unsigned long min_block_size;
+	struct dsp_cmm_seg_info info[1];
+};
+
+struct cmm_object;
+
+struct cmm_get_handle {
+	void *proc_handle;
+	struct cmm_object **cmm;
+};
+
+struct cmm_get_info {
+	struct cmm_object *cmm;
+	struct dsp_cmm_info *info;
+};
+
+struct get_uuid_props {
+	void *proc_handle;
+	const struct dsp_uuid *node_uuid;
+	struct dsp_ndb_props *props;
+};
+
+struct node_allocate {
+	void *proc_handle;
+	const struct dsp_uuid *node_id;
+	const void *cb_data;
+	struct dsp_node_attr_in *attrs;
+	void **ret_node;
+};
+
+struct node_connect {
+	void *node_handle;
+	unsigned int stream;
+	void *other_node_handle;
+	unsigned int other_stream;
+	struct dsp_stream_attr *attrs;
+	void *params;
+};
+
+struct reserve_mem {
+	void *proc_handle;
+	unsigned long size;
+	void **addr;
+};
+
+struct unreserve_mem {
+	void *proc_handle;
+	unsigned long size;
+	void *addr;
+};
+
+struct map_mem {
+	void *proc_handle;
+	void *mpu_addr;
+	unsigned long size;
+	void *req_addr;
+	void **ret_map_addr;
+	unsigned long attr;
+};
+
+struct unmap_mem {
+	void *proc_handle;
+	unsigned long size;
+	void *map_addr;
+};
+
+struct flush_mem {
+	void *proc_handle;
+	void *mpu_addr;
+	unsigned long size;
+	unsigned long flags;
+};
+
+struct invalidate_mem {
+	void *proc_handle;
+	void *mpu_addr;
+	unsigned long size;
+};
+
+struct proc_get_info {
+	void *proc_handle;
+	unsigned type;
+	struct dsp_info *info;
+	unsigned size;
+};
+
+struct enum_nodes {
+	void *proc_handle;
+	void **node_table;
+	unsigned node_table_size;
+	unsigned *num_nodes;
+	unsigned *allocated;
+};
+
+struct stream_attr {
+	void *event;
+	char *name;
+	void *base;
+	unsigned long size;
+	struct dsp_stream_attr_in *attrin;
+};
+
+struct stream_open {
+	void *node_handle;
+	unsigned int direction;
+	unsigned int index;
+	struct stream_attr *attr;
+	void *stream;
+};
+
+struct stream_info {
+	enum dsp_stream_mode mode;
+	unsigned int segment;
+	void *base;
+	struct dsp_stream_info *info;
+};
+
+struct stream_get_info {
+	void *stream;
+	struct stream_info *info;
+	unsigned int size;
+};
+
+struct stream_idle {
+	void *stream;
+	bool flush;
+};
+
+struct stream_reclaim {
+	void *stream;
+	unsigned char **buff;
+	unsigned long *data_size;
+	unsigned long *buff_size;
+	unsigned long *flag;
+};
+
+struct stream_issue {
+	void *stream;
+	unsigned char *buff;
+	unsigned long data_size;
+	unsigned long buff_size;
+	unsigned long flag;
+};
+
+struct stream_allocate_buffer {
+	void *stream;
+	unsigned int size;
+	unsigned char **buff;
+	unsigned int num_buf;
+};
+
+struct stream_free_buffers {
+	void *stream;
+	unsigned char **buff;
+	unsigned int num_buf;
+};
+
+#endif /* DSP_IOCTL_H */
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "dsp_node_pool.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <time.h>
+
+/* how long a node has to acknowledge the reset, in ms */
+#define RESET_TIMEOUT 1000
+
+struct dsp_node_pool {
+	int handle;
+	void *proc_handle;
+	struct dsp_uuid uuid;
+	struct dsp_node_attr_in attrs;
+	bool has_attrs;
+	struct dsp_msg reset;
+	dsp_node_pool_setup_t setup;
+	void *data;
+	pthread_mutex_t lock;
+	struct dsp_node *idle[DSP_NODE_POOL_MAX];
+	unsigned int nr_idle;
+	struct dsp_node_pool_stats stats;
+};
+
+static inline uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static struct dsp_node *
+create_node(struct dsp_node_pool *pool)
+{
+	struct dsp_node *node;
+	/* the bridge fills in the heap */
+	struct dsp_node_attr_in attrs = pool->attrs;
+
+	if (!dsp_node_allocate(pool->handle, pool->proc_handle, &pool->uuid, NULL,
+				pool->has_attrs ? &attrs : NULL, &node)) {
+		pr_err("dsp node allocate failed");
+		return NULL;
+	}
+
+	if (pool->setup && !pool->setup(pool->handle, node, pool->data)) {
+		pr_err("node setup failed");
+		goto fail;
+	}
+
+	if (!dsp_node_create(pool->handle, node)) {
+		pr_err("dsp node create failed");
+		goto fail;
+	}
+
+	if (!dsp_node_run(pool->handle, node)) {
+		pr_err("dsp node run failed");
+		goto fail;
+	}
+
+	return node;
+
+fail:
+	dsp_node_free(pool->handle, node);
+	return NULL;
+}
+
+static bool
+destroy_node(struct dsp_node_pool *pool,
+		struct dsp_node *node)
+{
+	unsigned long exit_status;
+	bool ok = true;
+
+	if (!dsp_node_terminate(pool->handle, node, &exit_status)) {
+		pr_err("dsp node terminate failed: %lx", exit_status);
+		ok = false;
+	}
+
+	if (!dsp_node_free(pool->handle, node)) {
+		pr_err("dsp node free failed");
+		ok = false;
+	}
+
+	return ok;
+}
+
+/* drops whatever the node sent until the reset is acknowledged */
+static bool
+reset_node(struct dsp_node_pool *pool,
+		struct dsp_node *node)
+{
+	struct dsp_msg msg;
+	uint64_t deadline = now_ms() + RESET_TIMEOUT;
+
+	if (!dsp_node_put_message(pool->handle, node, &pool->reset, RESET_TIMEOUT))
+		return false;
+
+	while (true) {
+		uint64_t t = now_ms();
+
+		if (t >= deadline)
+			return false;
+		if (!dsp_node_get_message(pool->handle, node, &msg, deadline - t))
+			return false;
+		if (msg.cmd == pool->reset.cmd)
+			return true;
+	}
+}
+
+struct dsp_node_pool *dsp_node_pool_new(int handle,
+		void *proc_handle,
+		const struct dsp_uuid *uuid,
+		const struct dsp_node_attr_in *attrs,
+		const struct dsp_msg *reset,
+		dsp_node_pool_setup_t setup,
+		void *data)
+{
+	struct dsp_node_pool *pool;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	pool->handle = handle;
+	pool->proc_handle = proc_handle;
+	pool->uuid = *uuid;
+	if (attrs) {
+		pool->attrs = *attrs;
+		pool->has_attrs = true;
+	}
+	pool->reset = *reset;
+	pool->setup = setup;
+	pool->data = data;
+	pthread_mutex_init(&pool->lock, NULL);
+
+	return pool;
+}
+
+void dsp_node_pool_free(struct dsp_node_pool *pool)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool->nr_idle; i++)
+		destroy_node(pool, pool->idle[i]);
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+bool dsp_node_pool_fill(struct dsp_node_pool *pool,
+		unsigned int count)
+{
+	if (count > DSP_NODE_POOL_MAX)
+		count = DSP_NODE_POOL_MAX;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->nr_idle < count) {
+		struct dsp_node *node;
+
+		/* creating takes long; don't hold up leases meanwhile */
+		pthread_mutex_unlock(&pool->lock);
+		node = create_node(pool);
+		pthread_mutex_lock(&pool->lock);
+
+		if (!node) {
+			pthread_mutex_unlock(&pool->lock);
+			return false;
+		}
+		if (pool->nr_idle == DSP_NODE_POOL_MAX) {
+			pthread_mutex_unlock(&pool->lock);
+			destroy_node(pool, node);
+			return true;
+		}
+		pool->idle[pool->nr_idle++] = node;
+		pool->stats.idle = pool->nr_idle;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return true;
+}
+
+struct dsp_node *dsp_node_pool_lease(struct dsp_node_pool *pool)
+{
+	struct dsp_node *node;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->nr_idle) {
+		node = pool->idle[--pool->nr_idle];
+		pool->stats.warm++;
+		pool->stats.idle = pool->nr_idle;
+		pthread_mutex_unlock(&pool->lock);
+		return node;
+	}
+	pool->stats.cold++;
+	pthread_mutex_unlock(&pool->lock);
+
+	return create_node(pool);
+}
+
+bool dsp_node_pool_return(struct dsp_node_pool *pool,
+		struct dsp_node *node)
+{
+	bool ok = reset_node(pool, node);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stats.resets++;
+	if (!ok) {
+		pool->stats.failed++;
+		pr_warning("node %p failed to reset", node);
+	} else if (pool->nr_idle < DSP_NODE_POOL_MAX) {
+		pool->idle[pool->nr_idle++] = node;
+		pool->stats.idle = pool->nr_idle;
+		pthread_mutex_unlock(&pool->lock);
+		return true;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return destroy_node(pool, node) && ok;
+}
+
+bool dsp_node_pool_discard(struct dsp_node_pool *pool,
+		struct dsp_node *node)
+{
+	return destroy_node(pool, node);
+}
+
+void dsp_node_pool_get_stats(struct dsp_node_pool *pool,
+		struct dsp_node_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool->lock);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->lock);
+}
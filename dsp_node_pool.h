@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef DSP_NODE_POOL_H
+#define DSP_NODE_POOL_H
+
+#include <stdbool.h>
+
+#include "dsp_bridge.h"
+
+/*
+ * Keeps nodes of one uuid allocated, created and running, and leases them
+ * out, so starting a session doesn't load anything on the DSP.
+ *
+ * A returned node is sent the reset message and goes back to the pool once
+ * the node replies with the same command; anything it sent before is
+ * dropped. A node that doesn't reply in time is terminated and freed, as
+ * are returned nodes beyond DSP_NODE_POOL_MAX.
+ *
+ * The uuid must already be registered. The setup callback, if any, is
+ * called before each node is created, e.g. to connect its streams.
+ */
+
+#define DSP_NODE_POOL_MAX 16
+
+struct dsp_node_pool;
+
+typedef bool (*dsp_node_pool_setup_t)(int handle,
+		struct dsp_node *node,
+		void *data);
+
+struct dsp_node_pool_stats {
+	unsigned long warm; /* leases served by the pool */
+	unsigned long cold; /* leases that had to create a node */
+	unsigned long resets;
+	unsigned long failed; /* nodes dropped because they didn't reset */
+	unsigned int idle;
+};
+
+struct dsp_node_pool *dsp_node_pool_new(int handle,
+		void *proc_handle,
+		const struct dsp_uuid *uuid,
+		const struct dsp_node_attr_in *attrs,
+		const struct dsp_msg *reset,
+		dsp_node_pool_setup_t setup,
+		void *data);
+
+/* terminates and frees the idle nodes; leased ones have to be returned first */
+void dsp_node_pool_free(struct dsp_node_pool *pool);
+
+/* creates nodes until 'count' are idle */
+bool dsp_node_pool_fill(struct dsp_node_pool *pool,
+		unsigned int count);
+
+struct dsp_node *dsp_node_pool_lease(struct dsp_node_pool *pool);
+
+bool dsp_node_pool_return(struct dsp_node_pool *pool,
+		struct dsp_node *node);
+
+/* for nodes that shouldn't be reused */
+bool dsp_node_pool_discard(struct dsp_node_pool *pool,
+		struct dsp_node *node);
+
+void dsp_node_pool_get_stats(struct dsp_node_pool *pool,
+		struct dsp_node_pool_stats *stats);
+
+#endif /* DSP_NODE_POOL_H */
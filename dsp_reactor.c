@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "dsp_reactor.h"
+#include "log.h"
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * How often the thread notices added nodes, in ms; also how long removing
+ * one can take, as MGR_WAIT can't be interrupted.
+ */
+#define REACTOR_TIMEOUT 100
+
+struct reactor_entry {
+	struct dsp_node *node;
+	struct dsp_notification notify;
+	bool busy; /* being added or removed */
+};
+
+struct reactor_msg {
+	struct dsp_node *node;
+	struct dsp_msg msg;
+};
+
+struct dsp_reactor {
+	int handle;
+	int fd;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_cond_t idle;
+	bool quit;
+	/* waiting on, or draining, the nodes it had when it started */
+	bool polling;
+	unsigned long cycles;
+	struct reactor_entry entries[DSP_REACTOR_MAX_NODES];
+	unsigned int nr_entries;
+	/* ring of drained messages, grown as needed */
+	struct reactor_msg *queue;
+	unsigned int size, head, count;
+};
+
+static bool
+queue_push(struct dsp_reactor *r,
+		struct dsp_node *node,
+		const struct dsp_msg *msg)
+{
+	struct reactor_msg *e;
+
+	if (r->count == r->size) {
+		unsigned int i, size = r->size ? r->size * 2 : 32;
+		struct reactor_msg *queue;
+
+		queue = malloc(size * sizeof(*queue));
+		if (!queue)
+			return false;
+		for (i = 0; i < r->count; i++)
+			queue[i] = r->queue[(r->head + i) % r->size];
+		free(r->queue);
+		r->queue = queue;
+		r->size = size;
+		r->head = 0;
+	}
+
+	e = &r->queue[(r->head + r->count++) % r->size];
+	e->node = node;
+	e->msg = *msg;
+	return true;
+}
+
+/* called without the lock; only the queue needs it, the ioctls never block */
+static unsigned int
+drain(struct dsp_reactor *r,
+		struct dsp_node *node)
+{
+	struct dsp_msg msg;
+	unsigned int n = 0;
+
+	while (dsp_node_get_message(r->handle, node, &msg, 0)) {
+		bool ok;
+
+		pthread_mutex_lock(&r->lock);
+		ok = queue_push(r, node, &msg);
+		pthread_mutex_unlock(&r->lock);
+		if (!ok) {
+			pr_err("lost message from %p", node);
+			continue;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+static void
+wakeup(struct dsp_reactor *r)
+{
+	uint64_t one = 1;
+
+	if (write(r->fd, &one, sizeof(one)) < 0)
+		pr_err("eventfd write failed: %d", errno);
+}
+
+static void *
+reactor_thread(void *data)
+{
+	struct dsp_reactor *r = data;
+	struct dsp_notification *notifications[DSP_REACTOR_MAX_NODES];
+	struct dsp_node *nodes[DSP_REACTOR_MAX_NODES];
+
+	pthread_mutex_lock(&r->lock);
+	while (!r->quit) {
+		unsigned int i, count = 0, index;
+		bool ok;
+		int err;
+
+		for (i = 0; i < r->nr_entries; i++) {
+			if (!r->entries[i].node)
+				continue;
+			nodes[count] = r->entries[i].node;
+			notifications[count++] = &r->entries[i].notify;
+		}
+
+		if (!count) {
+			pthread_cond_wait(&r->cond, &r->lock);
+			continue;
+		}
+
+		/* nodes being removed stay registered until this is over */
+		r->polling = true;
+		pthread_mutex_unlock(&r->lock);
+		ok = dsp_wait_for_events(r->handle, notifications, count, &index, REACTOR_TIMEOUT);
+		err = errno;
+		pthread_mutex_lock(&r->lock);
+
+		if (!ok) {
+			if (err != ETIME)
+				pr_err("wait for events failed: %d", err);
+			goto next;
+		}
+
+		/* the node might be on its way out */
+		for (i = 0; i < r->nr_entries; i++)
+			if (r->entries[i].node == nodes[index])
+				break;
+		if (i == r->nr_entries)
+			goto next;
+
+		/*
+		 * Notifications are only a hint; pick up everything that is ready
+		 * so a burst costs a single wakeup.
+		 */
+		pthread_mutex_unlock(&r->lock);
+		if (drain(r, nodes[index]))
+			wakeup(r);
+		pthread_mutex_lock(&r->lock);
+
+next:
+		r->polling = false;
+		r->cycles++;
+		pthread_cond_broadcast(&r->idle);
+	}
+	pthread_mutex_unlock(&r->lock);
+
+	return NULL;
+}
+
+struct dsp_reactor *dsp_reactor_new(int handle)
+{
+	struct dsp_reactor *r;
+
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	r->handle = handle;
+	r->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (r->fd < 0) {
+		pr_err("eventfd failed: %d", errno);
+		free(r);
+		return NULL;
+	}
+
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	pthread_cond_init(&r->idle, NULL);
+
+	if (pthread_create(&r->thread, NULL, reactor_thread, r)) {
+		pr_err("failed to create thread");
+		pthread_cond_destroy(&r->idle);
+		pthread_cond_destroy(&r->cond);
+		pthread_mutex_destroy(&r->lock);
+		close(r->fd);
+		free(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+void dsp_reactor_free(struct dsp_reactor *r)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&r->lock);
+	r->quit = true;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+	pthread_join(r->thread, NULL);
+
+	for (i = 0; i < r->nr_entries; i++)
+		if (r->entries[i].node)
+			dsp_reactor_remove(r, r->entries[i].node);
+
+	pthread_cond_destroy(&r->idle);
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+	close(r->fd);
+	free(r->queue);
+	free(r);
+}
+
+bool dsp_reactor_add(struct dsp_reactor *r,
+		struct dsp_node *node)
+{
+	struct reactor_entry *e = NULL;
+	unsigned int i;
+
+	pthread_mutex_lock(&r->lock);
+
+	for (i = 0; i < r->nr_entries; i++) {
+		if (!r->entries[i].node && !r->entries[i].busy) {
+			e = &r->entries[i];
+			break;
+		}
+	}
+	if (!e) {
+		if (r->nr_entries == DSP_REACTOR_MAX_NODES) {
+			pr_err("too many nodes");
+			pthread_mutex_unlock(&r->lock);
+			return false;
+		}
+		e = &r->entries[r->nr_entries++];
+	}
+	e->busy = true;
+
+	pthread_mutex_unlock(&r->lock);
+
+	if (!dsp_node_register_notify(r->handle, node,
+				DSP_NODEMESSAGEREADY, DSP_SIGNALEVENT, &e->notify)) {
+		pr_err("failed to register notification");
+		pthread_mutex_lock(&r->lock);
+		e->busy = false;
+		pthread_mutex_unlock(&r->lock);
+		return false;
+	}
+
+	/*
+	 * Replies that arrived before the registration; the thread doesn't
+	 * know the node yet, so they can't be picked up out of order.
+	 */
+	if (drain(r, node))
+		wakeup(r);
+
+	pthread_mutex_lock(&r->lock);
+	e->node = node;
+	e->busy = false;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+
+	return true;
+}
+
+bool dsp_reactor_remove(struct dsp_reactor *r,
+		struct dsp_node *node)
+{
+	struct reactor_entry *e = NULL;
+	unsigned long cycle;
+	unsigned int i;
+
+	pthread_mutex_lock(&r->lock);
+
+	for (i = 0; i < r->nr_entries; i++) {
+		if (r->entries[i].node == node) {
+			e = &r->entries[i];
+			break;
+		}
+	}
+	if (!e) {
+		pthread_mutex_unlock(&r->lock);
+		return false;
+	}
+
+	e->node = NULL;
+	e->busy = true;
+
+	/* the next wait leaves it out; the current one might still use it */
+	cycle = r->cycles;
+	while (r->polling && r->cycles == cycle)
+		pthread_cond_wait(&r->idle, &r->lock);
+
+	pthread_mutex_unlock(&r->lock);
+
+	if (!dsp_node_register_notify(r->handle, node, 0, DSP_SIGNALEVENT, &e->notify))
+		pr_warning("failed to unregister notification");
+
+	pthread_mutex_lock(&r->lock);
+	e->busy = false;
+	pthread_mutex_unlock(&r->lock);
+
+	return true;
+}
+
+int dsp_reactor_fd(struct dsp_reactor *r)
+{
+	return r->fd;
+}
+
+bool dsp_reactor_get_message(struct dsp_reactor *r,
+		struct dsp_node **node,
+		struct dsp_msg *message)
+{
+	struct reactor_msg *e;
+
+	pthread_mutex_lock(&r->lock);
+	if (!r->count) {
+		pthread_mutex_unlock(&r->lock);
+		return false;
+	}
+
+	e = &r->queue[r->head];
+	r->head = (r->head + 1) % r->size;
+	r->count--;
+	*node = e->node;
+	*message = e->msg;
+	pthread_mutex_unlock(&r->lock);
+
+	return true;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef DSP_REACTOR_H
+#define DSP_REACTOR_H
+
+#include <stdbool.h>
+
+#include "dsp_bridge.h"
+
+/*
+ * Waits for DSP_NODEMESSAGEREADY on a set of nodes from a single thread and
+ * hands the replies over through an eventfd, so they can be polled along
+ * with any other file descriptor.
+ *
+ * When the fd becomes readable, read it to clear it and then call
+ * dsp_reactor_get_message() until it returns false. Nodes must be removed
+ * before they are deleted; removing one waits until the thread is no longer
+ * waiting on it, which can take up to a tenth of a second.
+ */
+
+#define DSP_REACTOR_MAX_NODES 16
+
+struct dsp_reactor;
+
+struct dsp_reactor *dsp_reactor_new(int handle);
+
+void dsp_reactor_free(struct dsp_reactor *reactor);
+
+bool dsp_reactor_add(struct dsp_reactor *reactor,
+		struct dsp_node *node);
+
+bool dsp_reactor_remove(struct dsp_reactor *reactor,
+		struct dsp_node *node);
+
+int dsp_reactor_fd(struct dsp_reactor *reactor);
+
+bool dsp_reactor_get_message(struct dsp_reactor *reactor,
+		struct dsp_node **node,
+		struct dsp_msg *message);
+
+#endif /* DSP_REACTOR_H */
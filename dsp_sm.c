@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "dsp_sm.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define BLOCK_SIZE(order) ((size_t) 1 << ((order) + DSP_SM_MIN_SHIFT))
+
+/* per block tags; only the first block of a buddy block is tagged */
+#define TAG_FREE 0x40
+#define TAG_USED 0x80
+#define TAG_ORDER 0x3f
+
+struct dsp_sm {
+	int handle;
+	struct dsp_node *node;
+	unsigned char *base;
+	uint32_t dsp_base;
+	size_t size;
+	unsigned int nr_blocks;
+	int free_head[DSP_SM_MAX_ORDER + 1];
+	int *next;
+	int *prev;
+	unsigned char *tag;
+	pthread_mutex_t lock;
+	struct dsp_sm_stats stats;
+};
+
+static void
+list_add(struct dsp_sm *sm,
+		int block,
+		unsigned int order)
+{
+	sm->next[block] = sm->free_head[order];
+	sm->prev[block] = -1;
+	if (sm->free_head[order] >= 0)
+		sm->prev[sm->free_head[order]] = block;
+	sm->free_head[order] = block;
+	sm->tag[block] = TAG_FREE | order;
+}
+
+static void
+list_del(struct dsp_sm *sm,
+		int block,
+		unsigned int order)
+{
+	if (sm->prev[block] >= 0)
+		sm->next[sm->prev[block]] = sm->next[block];
+	else
+		sm->free_head[order] = sm->next[block];
+	if (sm->next[block] >= 0)
+		sm->prev[sm->next[block]] = sm->prev[block];
+	sm->tag[block] = 0;
+}
+
+struct dsp_sm *dsp_sm_new(int handle,
+		struct dsp_node *node,
+		size_t size)
+{
+	struct dsp_sm *sm;
+	void *base;
+	uint32_t dsp_base;
+	unsigned int i, block;
+
+	size &= ~(BLOCK_SIZE(0) - 1);
+	if (!size)
+		return NULL;
+
+	if (!dsp_node_alloc_sm(handle, node, size, &base, &dsp_base)) {
+		pr_err("failed to get %zu bytes of shared memory", size);
+		return NULL;
+	}
+
+	sm = calloc(1, sizeof(*sm));
+	if (!sm) {
+		dsp_node_free_sm(handle, node, base);
+		return NULL;
+	}
+
+	pthread_mutex_init(&sm->lock, NULL);
+
+	sm->handle = handle;
+	sm->node = node;
+	sm->base = base;
+	sm->dsp_base = dsp_base;
+	sm->size = size;
+	sm->nr_blocks = size >> DSP_SM_MIN_SHIFT;
+	sm->next = malloc(sm->nr_blocks * sizeof(*sm->next));
+	sm->prev = malloc(sm->nr_blocks * sizeof(*sm->prev));
+	sm->tag = calloc(sm->nr_blocks, 1);
+	if (!sm->next || !sm->prev || !sm->tag) {
+		dsp_sm_free(sm);
+		return NULL;
+	}
+
+	for (i = 0; i <= DSP_SM_MAX_ORDER; i++)
+		sm->free_head[i] = -1;
+
+	/* cover the arena with the biggest naturally aligned blocks */
+	for (block = 0; block < sm->nr_blocks; ) {
+		unsigned int order = DSP_SM_MAX_ORDER;
+
+		while ((block & ((1U << order) - 1)) || block + (1U << order) > sm->nr_blocks)
+			order--;
+		list_add(sm, block, order);
+		block += 1U << order;
+	}
+
+	sm->stats.size = size;
+
+	pr_info("%p: %zu bytes at %p, dsp %x", sm, size, base, dsp_base);
+
+	return sm;
+}
+
+void dsp_sm_free(struct dsp_sm *sm)
+{
+	if (!sm)
+		return;
+
+	if (sm->stats.used)
+		pr_warning("%p: %zu bytes still allocated", sm, sm->stats.used);
+
+	if (!dsp_node_free_sm(sm->handle, sm->node, sm->base))
+		pr_err("%p: failed to give back the arena", sm);
+
+	pthread_mutex_destroy(&sm->lock);
+	free(sm->next);
+	free(sm->prev);
+	free(sm->tag);
+	free(sm);
+}
+
+void *dsp_sm_alloc(struct dsp_sm *sm,
+		size_t size,
+		uint32_t *dsp_addr)
+{
+	unsigned int order = 0, o;
+	int block;
+
+	while (order < DSP_SM_MAX_ORDER && BLOCK_SIZE(order) < size)
+		order++;
+
+	pthread_mutex_lock(&sm->lock);
+
+	for (o = order; o <= DSP_SM_MAX_ORDER; o++)
+		if (sm->free_head[o] >= 0)
+			break;
+
+	if (o > DSP_SM_MAX_ORDER || BLOCK_SIZE(order) < size) {
+		sm->stats.failures++;
+		pthread_mutex_unlock(&sm->lock);
+		return NULL;
+	}
+
+	block = sm->free_head[o];
+	list_del(sm, block, o);
+
+	/* split, keeping the upper halves */
+	while (o > order) {
+		o--;
+		list_add(sm, block + (1 << o), o);
+	}
+
+	sm->tag[block] = TAG_USED | order;
+	sm->stats.allocs++;
+	sm->stats.used += BLOCK_SIZE(order);
+	if (sm->stats.used > sm->stats.high_water)
+		sm->stats.high_water = sm->stats.used;
+
+	pthread_mutex_unlock(&sm->lock);
+
+	if (dsp_addr)
+		*dsp_addr = sm->dsp_base + ((uint32_t) block << DSP_SM_MIN_SHIFT);
+
+	return sm->base + ((size_t) block << DSP_SM_MIN_SHIFT);
+}
+
+void dsp_sm_release(struct dsp_sm *sm,
+		void *ptr)
+{
+	unsigned char *p = ptr;
+	unsigned int order;
+	int block;
+
+	if (!ptr)
+		return;
+
+	if (p < sm->base || p >= sm->base + sm->size ||
+			((p - sm->base) & (BLOCK_SIZE(0) - 1))) {
+		pr_err("%p: bad pointer %p", sm, ptr);
+		return;
+	}
+
+	block = (p - sm->base) >> DSP_SM_MIN_SHIFT;
+
+	pthread_mutex_lock(&sm->lock);
+
+	if (!(sm->tag[block] & TAG_USED)) {
+		pthread_mutex_unlock(&sm->lock);
+		pr_err("%p: %p not allocated", sm, ptr);
+		return;
+	}
+
+	order = sm->tag[block] & TAG_ORDER;
+	sm->stats.used -= BLOCK_SIZE(order);
+	sm->tag[block] = 0;
+
+	/* merge with the buddy as long as it's free as a whole */
+	while (order < DSP_SM_MAX_ORDER) {
+		unsigned int buddy = block ^ (1U << order);
+
+		if (buddy >= sm->nr_blocks || sm->tag[buddy] != (TAG_FREE | order))
+			break;
+		list_del(sm, buddy, order);
+		if ((int) buddy < block)
+			block = buddy;
+		order++;
+	}
+
+	list_add(sm, block, order);
+
+	pthread_mutex_unlock(&sm->lock);
+}
+
+void dsp_sm_get_stats(struct dsp_sm *sm,
+		struct dsp_sm_stats *stats)
+{
+	unsigned int order;
+
+	pthread_mutex_lock(&sm->lock);
+
+	*stats = sm->stats;
+	stats->free = 0;
+	stats->largest_free = 0;
+	stats->free_blocks = 0;
+
+	for (order = 0; order <= DSP_SM_MAX_ORDER; order++) {
+		int block;
+
+		for (block = sm->free_head[order]; block >= 0; block = sm->next[block]) {
+			stats->free += BLOCK_SIZE(order);
+			stats->free_blocks++;
+			if (BLOCK_SIZE(order) > stats->largest_free)
+				stats->largest_free = BLOCK_SIZE(order);
+		}
+	}
+
+	pthread_mutex_unlock(&sm->lock);
+
+	stats->fragmentation = stats->free ?
+		100 - stats->largest_free * 100 / stats->free : 0;
+}
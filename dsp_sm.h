@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef DSP_SM_H
+#define DSP_SM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsp_bridge.h"
+
+/*
+ * Buddy allocator over an arena of the CMM shared memory segment. The
+ * memory is physically contiguous and already visible to the DSP, so the
+ * blocks need no dsp_reserve()/dsp_map(), and the segment is not cached on
+ * the GPP side.
+ *
+ * The arena is taken from the node's message buffer space and given back by
+ * dsp_sm_free(), which has to be called before the node is freed.
+ */
+
+/* the DSP's L2 cache line */
+#define DSP_SM_MIN_SHIFT 7
+#define DSP_SM_MAX_ORDER 24
+
+struct dsp_sm;
+
+struct dsp_sm_stats {
+	size_t size;
+	size_t used;
+	size_t high_water;
+	size_t free;
+	size_t largest_free;
+	unsigned int free_blocks;
+	/* percentage of the free memory outside the largest free block */
+	unsigned int fragmentation;
+	unsigned long allocs;
+	unsigned long failures;
+};
+
+struct dsp_sm *dsp_sm_new(int handle,
+		struct dsp_node *node,
+		size_t size);
+
+void dsp_sm_free(struct dsp_sm *sm);
+
+void *dsp_sm_alloc(struct dsp_sm *sm,
+		size_t size,
+		uint32_t *dsp_addr);
+
+void dsp_sm_release(struct dsp_sm *sm,
+		void *ptr);
+
+void dsp_sm_get_stats(struct dsp_sm *sm,
+		struct dsp_sm_stats *stats);
+
+#endif /* DSP_SM_H */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef DUMMY_H
+#define DUMMY_H
+
+#include <stdint.h>
+
+/* messages understood by the dummy node; shared by both sides */
+
+/* arg_1: input, arg_2: output, the same to work in place; each one adds a buffer slot */
+#define DUMMY_CMD_SETUP 0
+/*
+ * arg_1: size, arg_2: slot; the reply has the bytes written in arg_1. The
+ * output must have room for what the kernel produces.
+ */
+#define DUMMY_CMD_RUN 1
+/* replied right away; no copy and no cache maintenance */
+#define DUMMY_CMD_NULL 2
+/*
+ * Copies between the connected streams until an empty input buffer comes;
+ * that one is passed on, and the reply has the number of buffers in arg_1.
+ */
+#define DUMMY_CMD_STREAM 3
+/* forgets the buffer slots; replied once they are no longer used */
+#define DUMMY_CMD_RESET 4
+/* arg_1: kernel, arg_2: its parameter; applies to the RUN commands after it */
+#define DUMMY_CMD_KERNEL 5
+/*
+ * arg_1: descriptor table, arg_2: slot; every input entry and the output
+ * entry after it are processed like a RUN, and the DSP writes the bytes
+ * produced in the output entry. The reply has the number of pairs in arg_1.
+ */
+#define DUMMY_CMD_BATCH 6
+
+/* what RUN does with the input */
+#define DUMMY_KERNEL_COPY 0
+/* the output is the CRC-32 (IEEE 802.3) of the input, little-endian */
+#define DUMMY_KERNEL_CRC32 1
+/* parameter: 32-bit key, little-endian */
+#define DUMMY_KERNEL_XOR 2
+#define DUMMY_KERNEL_SWAP16 3
+#define DUMMY_KERNEL_SWAP32 4
+/* 16-bit samples; parameter: Q8.8 gain, the result saturates */
+#define DUMMY_KERNEL_GAIN 5
+#define DUMMY_NR_KERNELS 6
+
+#define DUMMY_MAX_SLOTS 16
+#define DUMMY_MAX_NODES 16
+#define DUMMY_MAX_DESCS 64
+
+/* entries of the DUMMY_CMD_BATCH table; the addresses are the DSP's */
+#define DUMMY_DESC_OUTPUT 0x1
+
+struct dummy_desc {
+	uint32_t addr;
+	uint32_t len;
+	uint32_t flags;
+};
+
+struct dummy_desc_table {
+	uint32_t count;
+	struct dummy_desc desc[DUMMY_MAX_DESCS];
+};
+
+#endif /* DUMMY_H */
@@ -14,18 +14,121 @@
 #include <string.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "dmm_buffer.h"
 #include "dsp_bridge.h"
 #include "log.h"
+#include "dummy.h"
+#include "histogram.h"
+#include "dsp_reactor.h"
+#include "kernels.h"
+#include "dsp_node_pool.h"
+#include "dsp_dcd_cache.h"
 
 static unsigned long input_buffer_size = 0x1000;
 static unsigned long output_buffer_size = 0x1000;
-static bool done;
+static volatile sig_atomic_t done;
 static int ntimes;
+static unsigned int depth = 1;
+static unsigned int nr_nodes = 1;
+static bool bench;
+static bool json;
+static bool null_cmd;
+static bool use_reactor;
+static bool show_stats;
+static bool use_sm;
+static int kernel = -1;
+static uint32_t kernel_param;
+static bool verify;
+static int profile = -1;
+static unsigned int sessions = 1;
+static bool cold;
+static bool use_pool;
+static unsigned int user_buffers;
+static size_t map_budget;
 
-static int dsp_handle;
-static void *proc;
+/* what the tasks' map caches did, for print_stats() */
+static struct {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+} map_stats;
+
+#define MAX_NODES 16
+#define MAX_USER_BUFFERS 64
+/* every slot in flight, and the reset */
+#define INBOX_SIZE (DUMMY_MAX_SLOTS + 1)
+
+enum transport {
+	TRANSPORT_MESSAGE,
+	TRANSPORT_STREAM,
+	TRANSPORT_LARGE_PAGES, /* messages, with buffers mapped in large pages */
+	TRANSPORT_IN_PLACE, /* messages, with a single bidirectional buffer */
+	TRANSPORT_BATCH, /* many buffers per message, in a descriptor table */
+	NR_TRANSPORTS,
+};
+
+static const char *transport_names[] = { "messages", "streams", "large pages", "in place", "batches" };
+static unsigned int batch = 8;
+static unsigned int transports = 1 << TRANSPORT_MESSAGE;
+
+static const struct dsp_uuid dummy_uuid = { 0x3dac26d0, 0x6d4b, 0x11dd, 0xad, 0x8b,
+	{ 0x08, 0x00, 0x20, 0x0c, 0x9a, 0x66 } };
+
+/* what the DCD says about the node, as built from dummy_bridge.s */
+static struct dsp_ndb_props node_props;
+/* by this process, rather than trusting the registration record */
+static bool registered;
+
+struct result {
+	unsigned int slots;
+	unsigned long completed;
+	unsigned long skipped;
+	uint64_t start, end;
+	struct histogram *latency;
+	size_t sm_size;
+	size_t sm_high_water;
+	unsigned int sm_fragmentation;
+	unsigned long errors;
+	uint64_t arm_ns;
+	size_t mapped;
+	unsigned long maintained;
+	unsigned long pool_hits;
+	unsigned long pool_misses;
+};
+
+/*
+ * Everything a worker touches; the bridge handle and processor are shared,
+ * but nothing else is, so each task can run on its own thread.
+ */
+struct task {
+	unsigned int id;
+	int dsp_handle;
+	void *proc;
+	struct dsp_node *node;
+	unsigned long times;
+	pthread_t thread;
+	pthread_barrier_t *barrier;
+	bool ok;
+	unsigned char fill;
+
+	/* shared by all the tasks; replies are sorted out into the inboxes */
+	struct dsp_reactor *reactor;
+	struct dsp_msg inbox[INBOX_SIZE];
+	unsigned int inbox_head, inbox_count;
+
+	/* memory of the user's own for the inputs, mapped through the cache */
+	struct dmm_map_cache *cache;
+	void *frames[MAX_USER_BUFFERS];
+	unsigned int next_frame;
+
+	struct result result[NR_TRANSPORTS];
+};
 
 static void
 signal_handler(int signal)
@@ -33,130 +136,1313 @@ signal_handler(int signal)
 	done = true;
 }
 
-static inline struct dsp_node *
-create_node(void)
-{
-	struct dsp_node *node;
-	const struct dsp_uuid dummy_uuid = { 0x3dac26d0, 0x6d4b, 0x11dd, 0xad, 0x8b,
-		{ 0x08, 0x00, 0x20, 0x0c, 0x9a, 0x66 } };
+static bool
+register_node(int dsp_handle,
+		bool force)
+{
+	unsigned int i, num;
+
+	if (!dsp_register_cached(dsp_handle, &dummy_uuid, "/lib/dsp/dummy.dll64P",
+				force, &registered))
+		return false;
+
+	/* read back the properties the node was registered with */
+	for (i = 0; dsp_enum(dsp_handle, i, &node_props, sizeof(node_props), &num); i++) {
+		if (!memcmp(&node_props.node_id, &dummy_uuid, sizeof(dummy_uuid))) {
+			pr_info("node '%s': priority %d, stack %u, message depth %u, streams %u/%u",
+					node_props.ac_name, node_props.prio, node_props.stack_size,
+					node_props.message_depth,
+					node_props.num_input_streams, node_props.num_output_streams);
+			return true;
+		}
+	}
+
+	if (!registered) {
+		pr_warning("stale registration record");
+		return register_node(dsp_handle, true);
+	}
+
+	pr_err("dsp enum failed to find the node");
+	return false;
+}
+
+/* the registration record might be stale, e.g. if the bridge was reloaded */
+static inline bool
+register_again(int dsp_handle)
+{
+	if (registered)
+		return false;
+
+	pr_warning("node allocation failed, registering it again");
+	return register_node(dsp_handle, true);
+}
+
+/* the streams have to be connected before the node is created */
+static bool
+connect_streams(int dsp_handle,
+		struct dsp_node *node,
+		void *data)
+{
+	struct dsp_stream_attr attrs = {
+		.buf_size = input_buffer_size,
+		.num_bufs = DUMMY_MAX_SLOTS,
+		.timeout = -1,
+		.mode = STRMMODE_ZEROCOPY,
+	};
+
+	if (!(transports & (1 << TRANSPORT_STREAM)))
+		return true;
+
+	if (!dsp_node_connect(dsp_handle, NULL, 0, node, 0, &attrs, NULL) ||
+			!dsp_node_connect(dsp_handle, node, 0, NULL, 0, &attrs, NULL)) {
+		pr_err("dsp node connect failed");
+		return false;
+	}
+
+	return true;
+}
+
+static inline bool
+release_node(struct dsp_node_pool *pool,
+		struct dsp_node *node)
+{
+	if (cold)
+		return dsp_node_pool_discard(pool, node);
+
+	return dsp_node_pool_return(pool, node);
+}
+
+static inline void
+configure_dsp_node(struct task *t,
+		dmm_buffer_t *input_buffer,
+		dmm_buffer_t *output_buffer)
+{
+	struct dsp_msg msg;
+
+	msg.cmd = DUMMY_CMD_SETUP;
+	msg.arg_1 = (uintptr_t) input_buffer->map;
+	msg.arg_2 = (uintptr_t) (output_buffer ? output_buffer : input_buffer)->map;
+	dsp_node_put_message(t->dsp_handle, t->node, &msg, -1);
+}
+
+static inline uint64_t
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+submit(struct task *t,
+		unsigned int slot,
+		dmm_buffer_t *input_buffer,
+		dmm_buffer_t *output_buffer)
+{
+	struct dsp_msg msg;
+	dmm_buffer_t *bufs[] = { input_buffer, output_buffer };
+	/* no output buffer when working in place */
+	unsigned int nr_bufs = output_buffer ? 2 : 1;
+
+	if (null_cmd) {
+		msg.cmd = DUMMY_CMD_NULL;
+		msg.arg_1 = 0;
+		msg.arg_2 = slot;
+		dsp_node_put_message(t->dsp_handle, t->node, &msg, -1);
+		return;
+	}
+
+#ifdef FILL_DATA
+	{
+		unsigned int i;
+		for (i = 0; i < input_buffer->size; i++)
+			((char *) input_buffer->data)[i] = t->fill;
+		t->fill++;
+		dmm_buffer_dirty(input_buffer, 0, input_buffer->size);
+	}
+#endif
+	dmm_buffer_begin_v(bufs, NULL, nr_bufs);
+	msg.cmd = DUMMY_CMD_RUN;
+	msg.arg_1 = input_buffer->size;
+	msg.arg_2 = slot;
+	dsp_node_put_message(t->dsp_handle, t->node, &msg, -1);
+}
+
+static inline unsigned int
+max_depth(void)
+{
+	unsigned int max = DUMMY_MAX_SLOTS;
+
+	/* every slot in flight needs room in the node's message queue */
+	if (node_props.message_depth && node_props.message_depth < max)
+		max = node_props.message_depth;
+
+	return max;
+}
+
+static struct task *all_tasks;
+static pthread_mutex_t inbox_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t inbox_cond = PTHREAD_COND_INITIALIZER;
+static bool inbox_polling;
+
+/* called with the inbox lock held */
+static void
+inbox_push(struct dsp_node *node,
+		const struct dsp_msg *msg)
+{
+	struct task *t = NULL;
+	unsigned int i;
+
+	for (i = 0; i < nr_nodes; i++) {
+		if (all_tasks[i].node == node) {
+			t = &all_tasks[i];
+			break;
+		}
+	}
+
+	if (!t || t->inbox_count == INBOX_SIZE) {
+		pr_err("lost message from %p", node);
+		return;
+	}
+
+	t->inbox[(t->inbox_head + t->inbox_count++) % INBOX_SIZE] = *msg;
+}
+
+static bool
+inbox_pop(struct task *t,
+		struct dsp_msg *msg)
+{
+	if (!t->inbox_count)
+		return false;
+
+	*msg = t->inbox[t->inbox_head];
+	t->inbox_head = (t->inbox_head + 1) % INBOX_SIZE;
+	t->inbox_count--;
+	return true;
+}
+
+/*
+ * With the reactor, whichever task finds a reply hands it to the task of the
+ * node; only one of them polls the fd, the rest wait for it.
+ */
+static bool
+get_message(struct task *t,
+		struct dsp_msg *msg)
+{
+	struct pollfd pfd;
+
+	if (!t->reactor)
+		return dsp_node_get_message(t->dsp_handle, t->node, msg, -1);
+
+	pfd.fd = dsp_reactor_fd(t->reactor);
+	pfd.events = POLLIN;
+
+	pthread_mutex_lock(&inbox_lock);
+	while (!inbox_pop(t, msg)) {
+		struct dsp_node *from;
+		struct dsp_msg m;
+		uint64_t count;
+
+		if (dsp_reactor_get_message(t->reactor, &from, &m)) {
+			inbox_push(from, &m);
+			pthread_cond_broadcast(&inbox_cond);
+			continue;
+		}
+
+		if (inbox_polling) {
+			pthread_cond_wait(&inbox_cond, &inbox_lock);
+			continue;
+		}
+
+		inbox_polling = true;
+		pthread_mutex_unlock(&inbox_lock);
+		if (poll(&pfd, 1, -1) > 0 && read(pfd.fd, &count, sizeof(count)) < 0)
+			pr_debug("eventfd read failed");
+		pthread_mutex_lock(&inbox_lock);
+		inbox_polling = false;
+		pthread_cond_broadcast(&inbox_cond);
+	}
+	pthread_mutex_unlock(&inbox_lock);
+
+	return true;
+}
+
+static inline unsigned int
+get_slots(struct task *t)
+{
+	unsigned int slots = depth;
+
+	/* zero means as deep as the node allows */
+	if (slots == 0)
+		slots = max_depth();
+	if (slots > max_depth()) {
+		slots = max_depth();
+		pr_warning("depth limited to %u", slots);
+	}
+
+	return slots;
+}
+
+static void
+start_clock(struct task *t,
+		struct result *r)
+{
+	if (bench) {
+		r->latency = malloc(sizeof(*r->latency));
+		histogram_init(r->latency);
+	}
+
+	/* so the nodes really compete with each other */
+	if (t->barrier)
+		pthread_barrier_wait(t->barrier);
+
+	r->start = now();
+}
+
+/* a run that fails before it starts still has to let the others go */
+static void
+skip_clock(struct task *t,
+		struct result *r)
+{
+	if (!r->start && t->barrier)
+		pthread_barrier_wait(t->barrier);
+}
+
+/* something for the kernels to work on; the same every run */
+static void
+fill_pattern(unsigned char *p,
+		size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		p[i] = (i * 131 + (i >> 8)) ^ 0x5a;
+}
+
+static void
+fill_input(dmm_buffer_t *b)
+{
+	fill_pattern(b->data, b->size);
+	dmm_buffer_dirty(b, 0, b->size);
+}
+
+/* in place the last run overwrote the input */
+static void
+refill_input(dmm_buffer_t *b,
+		const unsigned char *pattern)
+{
+	if (!pattern)
+		return;
+	memcpy(b->data, pattern, b->size);
+	dmm_buffer_dirty(b, 0, b->size);
+}
+
+static bool
+check_output(struct task *t,
+		struct result *r,
+		const void *input,
+		size_t size,
+		const void *output,
+		size_t len,
+		unsigned char *scratch)
+{
+	size_t expected;
+
+	expected = kernel_run_ref(kernel, scratch, input, size, kernel_param);
+	if (len == expected && !memcmp(output, scratch, len))
+		return true;
+
+	if (!r->errors++)
+		pr_err("node %u: %s output doesn't match the reference", t->id, kernel_names[kernel]);
+	return false;
+}
+
+/* the same work the node did, on the ARM */
+static void
+run_arm(struct result *r,
+		dmm_buffer_t **input_buffers,
+		unsigned int slots,
+		unsigned char *scratch)
+{
+	unsigned long i;
+	uint64_t start;
+
+	start = now();
+	for (i = 0; i < r->completed; i++) {
+		dmm_buffer_t *b = input_buffers[i % slots];
+		kernel_run(kernel, scratch, b->data, input_buffer_size, kernel_param);
+	}
+	r->arm_ns = now() - start;
+}
+
+static bool
+run_messages(struct task *t,
+		struct result *r,
+		size_t page_size,
+		bool in_place)
+{
+	dmm_buffer_t *input_buffers[DUMMY_MAX_SLOTS] = { NULL };
+	dmm_buffer_t *output_buffers[DUMMY_MAX_SLOTS] = { NULL };
+	unsigned int i, slots, nr_setup = 0, in_flight = 0;
+	unsigned long sent = 0, times = t->times;
+	uint64_t submitted[DUMMY_MAX_SLOTS];
+	struct dsp_sm *sm = NULL;
+	unsigned char *scratch = NULL, *pattern = NULL;
+	bool ok = false, bad_reply = false;
+
+	slots = r->slots = get_slots(t);
+
+	if (kernel >= 0 && !null_cmd) {
+		/* at least room for a CRC */
+		scratch = malloc(input_buffer_size > 4 ? input_buffer_size : 4);
+		if (!scratch)
+			goto leave;
+		if (in_place) {
+			pattern = malloc(input_buffer_size);
+			if (!pattern)
+				goto leave;
+			fill_pattern(pattern, input_buffer_size);
+		}
+	}
+
+	if (use_sm) {
+		size_t block = 1 << DSP_SM_MIN_SHIFT, size = block;
+
+		while (block < input_buffer_size || block < output_buffer_size)
+			block <<= 1;
+		/* a single buddy block; anything left fragmented is a leak */
+		while (size < 2 * slots * block)
+			size <<= 1;
+		sm = dsp_sm_new(t->dsp_handle, t->node, size);
+		if (!sm) {
+			pr_err("failed to set up shared memory arena");
+			goto leave;
+		}
+	}
+
+	for (i = 0; i < slots; i++) {
+		if (in_place) {
+			/* one buffer, flushed before and invalidated after */
+			input_buffers[i] = dmm_buffer_new(t->dsp_handle, t->proc, DMA_BIDIRECTIONAL);
+			output_buffers[i] = NULL;
+		} else {
+			input_buffers[i] = dmm_buffer_new(t->dsp_handle, t->proc, DMA_TO_DEVICE);
+			output_buffers[i] = dmm_buffer_new(t->dsp_handle, t->proc, DMA_FROM_DEVICE);
+			output_buffers[i]->page_size = page_size;
+		}
+		input_buffers[i]->page_size = page_size;
+
+		if (sm) {
+			if (!dmm_buffer_allocate_sm(input_buffers[i], sm, input_buffer_size) ||
+					(output_buffers[i] &&
+					 !dmm_buffer_allocate_sm(output_buffers[i], sm, output_buffer_size))) {
+				pr_err("out of shared memory");
+				goto leave;
+			}
+		} else {
+			dmm_buffer_allocate(input_buffers[i], input_buffer_size);
+			if (output_buffers[i])
+				dmm_buffer_allocate(output_buffers[i], output_buffer_size);
+		}
+
+		if (scratch)
+			fill_input(input_buffers[i]);
+
+		if (output_buffers[i])
+			dmm_buffer_map(output_buffers[i]);
+		dmm_buffer_map(input_buffers[i]);
+
+		if (!sm) {
+			r->mapped += input_buffers[i]->size;
+			if (output_buffers[i])
+				r->mapped += output_buffers[i]->size;
+		}
+
+		configure_dsp_node(t, input_buffers[i], output_buffers[i]);
+		nr_setup++;
+	}
+
+	pr_info("running %lu times, %u in flight", times, slots);
+
+	start_clock(t, r);
+
+	for (i = 0; i < slots && (times == 0 || sent < times); i++) {
+		submitted[i] = now();
+		submit(t, i, input_buffers[i], output_buffers[i]);
+		sent++;
+		in_flight++;
+	}
+
+	while (in_flight) {
+		struct dsp_msg msg;
+		unsigned int slot;
+
+		get_message(t, &msg);
+		in_flight--;
+		r->completed++;
+
+		slot = msg.arg_2;
+		if (slot >= slots) {
+			/* the rest still has to come back */
+			pr_err("bad slot: %u", slot);
+			bad_reply = true;
+			continue;
+		}
+
+		if (r->latency)
+			histogram_record(r->latency, now() - submitted[slot]);
+
+		if (!null_cmd && in_place) {
+			dmm_buffer_t *b = input_buffers[slot];
+
+			dmm_buffer_end(b, msg.arg_1);
+
+			if (verify && scratch)
+				check_output(t, r, pattern, b->size, b->data, msg.arg_1, scratch);
+		} else if (!null_cmd) {
+			dmm_buffer_t *bufs[] = { input_buffers[slot], output_buffers[slot] };
+			/* the reply says how much was written */
+			size_t lens[] = { input_buffers[slot]->size, msg.arg_1 };
+
+			dmm_buffer_end_v(bufs, lens, 2);
+
+			if (verify && scratch)
+				check_output(t, r, input_buffers[slot]->data, input_buffers[slot]->size,
+						output_buffers[slot]->data, msg.arg_1, scratch);
+		}
+
+		if (!done && !bad_reply && (times == 0 || sent < times)) {
+			refill_input(input_buffers[slot], pattern);
+			submitted[slot] = now();
+			submit(t, slot, input_buffers[slot], output_buffers[slot]);
+			sent++;
+			in_flight++;
+		}
+	}
+
+	r->end = now();
+
+	if (scratch && !bad_reply)
+		run_arm(r, input_buffers, slots, scratch);
+	ok = !bad_reply;
+
+leave:
+	skip_clock(t, r);
+
+	/* the buffers are about to go away, and the next run sets up its own */
+	if (nr_setup) {
+		struct dsp_msg msg = { .cmd = DUMMY_CMD_RESET };
+
+		dsp_node_put_message(t->dsp_handle, t->node, &msg, -1);
+		get_message(t, &msg);
+	}
+
+	free(scratch);
+	free(pattern);
+
+	for (i = 0; i < slots; i++) {
+		if (output_buffers[i]) {
+			r->skipped += output_buffers[i]->skipped;
+			r->maintained += output_buffers[i]->maintained;
+			dmm_buffer_unmap(output_buffers[i]);
+			dmm_buffer_free(output_buffers[i]);
+		}
+		if (input_buffers[i]) {
+			r->skipped += input_buffers[i]->skipped;
+			r->maintained += input_buffers[i]->maintained;
+			dmm_buffer_unmap(input_buffers[i]);
+			dmm_buffer_free(input_buffers[i]);
+		}
+	}
+
+	if (sm) {
+		struct dsp_sm_stats stats;
+
+		dsp_sm_get_stats(sm, &stats);
+		r->sm_size = stats.size;
+		r->sm_high_water = stats.high_water;
+		r->sm_fragmentation = stats.fragmentation;
+		dsp_sm_free(sm);
+	}
+
+	return ok;
+}
+
+static void
+submit_batch(struct task *t,
+		unsigned int slot,
+		dmm_buffer_t *table,
+		dmm_buffer_t **input_buffers,
+		dmm_buffer_t **output_buffers,
+		unsigned int count)
+{
+	struct dummy_desc_table *descs = table->data;
+	dmm_buffer_t *bufs[2 * DUMMY_MAX_DESCS + 1];
+	size_t lens[2 * DUMMY_MAX_DESCS + 1];
+	struct dsp_msg msg;
+	unsigned int i, n = 0;
+
+	/* the buffers might be new, and the DSP wrote the output lengths last time */
+	descs->count = 2 * count;
+	for (i = 0; i < count; i++) {
+		descs->desc[2 * i].addr = (uintptr_t) input_buffers[i]->map;
+		descs->desc[2 * i].len = input_buffer_size;
+		descs->desc[2 * i + 1].addr = (uintptr_t) output_buffers[i]->map;
+		descs->desc[2 * i + 1].len = output_buffer_size;
+		descs->desc[2 * i + 1].flags = DUMMY_DESC_OUTPUT;
+	}
+	dmm_buffer_dirty(table, 0, sizeof(*descs));
+
+	bufs[n] = table;
+	lens[n++] = table->size;
+	for (i = 0; i < count; i++) {
+		/* pooled buffers can be larger than asked for */
+		bufs[n] = input_buffers[i];
+		lens[n++] = input_buffer_size;
+		bufs[n] = output_buffers[i];
+		lens[n++] = output_buffer_size;
+	}
+	dmm_buffer_begin_v(bufs, lens, n);
+
+	msg.cmd = DUMMY_CMD_BATCH;
+	msg.arg_1 = (uintptr_t) table->map;
+	msg.arg_2 = slot;
+	dsp_node_put_message(t->dsp_handle, t->node, &msg, -1);
+}
+
+/* the last batch only carries what's left */
+static inline unsigned int
+next_batch(unsigned long sent,
+		unsigned long times)
+{
+	if (times && times - sent < batch)
+		return times - sent;
+	return batch;
+}
+
+/* with a pool, only the buffers it didn't have yet get allocated and mapped */
+static dmm_buffer_t *
+get_buffer(struct task *t,
+		struct result *r,
+		struct dmm_buffer_pool *pool,
+		size_t size,
+		int dir)
+{
+	dmm_buffer_t *b;
+
+	if (pool) {
+		unsigned long misses = pool->misses;
+
+		b = dmm_buffer_pool_acquire(pool, size, dir);
+		if (pool->misses == misses)
+			return b;
+	} else {
+		b = dmm_buffer_new(t->dsp_handle, t->proc, dir);
+		dmm_buffer_allocate(b, size);
+		dmm_buffer_map(b);
+	}
+
+	r->mapped += b->size;
+	return b;
+}
+
+/* the next of the user's buffers in turn; the cache maps each one once */
+static dmm_buffer_t *
+use_frame(struct task *t)
+{
+	dmm_buffer_t *b;
+
+	b = dmm_buffer_new(t->dsp_handle, t->proc, DMA_TO_DEVICE);
+	b->cache = t->cache;
+	dmm_buffer_use(b, t->frames[t->next_frame++ % user_buffers], input_buffer_size);
+	dmm_buffer_map(b);
+
+	return b;
+}
+
+static void
+put_buffer(struct result *r,
+		struct dmm_buffer_pool *pool,
+		dmm_buffer_t *b)
+{
+	/* a pooled buffer comes back, don't count it twice */
+	r->skipped += b->skipped;
+	r->maintained += b->maintained;
+	b->skipped = b->maintained = 0;
+
+	if (pool) {
+		dmm_buffer_pool_release(pool, b);
+		return;
+	}
+
+	dmm_buffer_unmap(b);
+	dmm_buffer_free(b);
+}
+
+/* a buffer each way for every entry of a table */
+static void
+get_batch(struct task *t,
+		struct result *r,
+		struct dmm_buffer_pool *pool,
+		dmm_buffer_t **input_buffers,
+		dmm_buffer_t **output_buffers,
+		bool fill)
+{
+	unsigned int j;
+
+	for (j = 0; j < batch; j++) {
+		if (t->cache)
+			input_buffers[j] = use_frame(t);
+		else
+			input_buffers[j] = get_buffer(t, r, pool, input_buffer_size, DMA_TO_DEVICE);
+		output_buffers[j] = get_buffer(t, r, pool, output_buffer_size, DMA_FROM_DEVICE);
+		if (fill)
+			fill_input(input_buffers[j]);
+	}
+}
+
+static void
+put_batch(struct result *r,
+		struct dmm_buffer_pool *pool,
+		dmm_buffer_t **input_buffers,
+		dmm_buffer_t **output_buffers)
+{
+	unsigned int j;
+
+	for (j = 0; j < batch; j++) {
+		put_buffer(r, pool, input_buffers[j]);
+		put_buffer(r, pool, output_buffers[j]);
+	}
+}
+
+/*
+ * One message carries a whole table of buffers each way. With a buffer
+ * pool every batch gets its buffers from the pool, and gives them back once
+ * the reply is in, like a pipeline that doesn't keep its frames; with user
+ * buffers the inputs are the task's frames in turn.
+ */
+static bool
+run_batches(struct task *t,
+		struct result *r)
+{
+	dmm_buffer_t *tables[DUMMY_MAX_SLOTS];
+	dmm_buffer_t *input_buffers[DUMMY_MAX_SLOTS][DUMMY_MAX_DESCS / 2];
+	dmm_buffer_t *output_buffers[DUMMY_MAX_SLOTS][DUMMY_MAX_DESCS / 2];
+	dmm_buffer_t *all_inputs[DUMMY_MAX_SLOTS * DUMMY_MAX_DESCS / 2];
+	unsigned int i, j, slots, nr_tables = 0, in_flight = 0;
+	unsigned long sent = 0, times = t->times;
+	unsigned int counts[DUMMY_MAX_SLOTS];
+	uint64_t submitted[DUMMY_MAX_SLOTS];
+	struct dmm_buffer_pool *pool = NULL;
+	unsigned char *scratch = NULL;
+	bool ok = false, bad_reply = false;
+
+	slots = r->slots = get_slots(t);
+
+	if (kernel >= 0) {
+		scratch = malloc(input_buffer_size > 4 ? input_buffer_size : 4);
+		if (!scratch)
+			goto leave;
+	}
+
+	if (use_pool)
+		pool = dmm_buffer_pool_new(t->dsp_handle, t->proc);
+
+	for (i = 0; i < slots; i++) {
+		struct dummy_desc_table *descs;
+
+		/* the DSP writes the output lengths back */
+		tables[i] = dmm_buffer_new(t->dsp_handle, t->proc, DMA_BIDIRECTIONAL);
+		dmm_buffer_allocate(tables[i], sizeof(*descs));
+		descs = tables[i]->data;
+		memset(descs, 0, sizeof(*descs));
+
+		get_batch(t, r, pool, input_buffers[i], output_buffers[i], scratch != NULL);
+		for (j = 0; j < batch; j++)
+			all_inputs[i * batch + j] = input_buffers[i][j];
+
+		dmm_buffer_map(tables[i]);
+		r->mapped += tables[i]->size;
+		nr_tables++;
+	}
+
+	/* times counts buffers, not messages */
+	pr_info("running %lu times, %u in flight, %u buffers each", times, slots, batch);
+
+	start_clock(t, r);
+
+	for (i = 0; i < slots && (times == 0 || sent < times); i++) {
+		counts[i] = next_batch(sent, times);
+		submitted[i] = now();
+		submit_batch(t, i, tables[i], input_buffers[i], output_buffers[i], counts[i]);
+		sent += counts[i];
+		in_flight++;
+	}
+
+	while (in_flight) {
+		dmm_buffer_t *bufs[2 * DUMMY_MAX_DESCS];
+		size_t lens[2 * DUMMY_MAX_DESCS];
+		struct dummy_desc_table *descs;
+		struct dsp_msg msg;
+		unsigned int slot, n = 0;
+
+		get_message(t, &msg);
+		in_flight--;
+
+		slot = msg.arg_2;
+		if (slot >= slots) {
+			/* the rest still has to come back */
+			pr_err("bad slot: %u", slot);
+			bad_reply = true;
+			continue;
+		}
+
+		if (r->latency)
+			histogram_record(r->latency, now() - submitted[slot]);
+
+		if (msg.arg_1 != counts[slot])
+			pr_warning("node %u: %u of %u buffers processed", t->id, msg.arg_1, counts[slot]);
+		r->completed += msg.arg_1;
+
+		/* the table first, it has the lengths */
+		dmm_buffer_end(tables[slot], tables[slot]->size);
+		descs = tables[slot]->data;
+
+		for (j = 0; j < counts[slot]; j++) {
+			bufs[n] = input_buffers[slot][j];
+			lens[n++] = input_buffer_size;
+			bufs[n] = output_buffers[slot][j];
+			lens[n++] = descs->desc[2 * j + 1].len;
+		}
+		dmm_buffer_end_v(bufs, lens, n);
+
+		if (verify && scratch) {
+			for (j = 0; j < counts[slot]; j++)
+				check_output(t, r, input_buffers[slot][j]->data, input_buffer_size,
+						output_buffers[slot][j]->data, descs->desc[2 * j + 1].len, scratch);
+		}
+
+		if (!done && !bad_reply && (times == 0 || sent < times)) {
+			if (pool || t->cache) {
+				put_batch(r, pool, input_buffers[slot], output_buffers[slot]);
+				get_batch(t, r, pool, input_buffers[slot], output_buffers[slot], scratch != NULL);
+				for (j = 0; j < batch; j++)
+					all_inputs[slot * batch + j] = input_buffers[slot][j];
+			}
+			counts[slot] = next_batch(sent, times);
+			submitted[slot] = now();
+			submit_batch(t, slot, tables[slot], input_buffers[slot], output_buffers[slot],
+					counts[slot]);
+			sent += counts[slot];
+			in_flight++;
+		}
+	}
+
+	r->end = now();
+
+	if (scratch && !bad_reply)
+		run_arm(r, all_inputs, slots * batch, scratch);
+	ok = !bad_reply;
+
+leave:
+	skip_clock(t, r);
+	free(scratch);
+
+	for (i = 0; i < nr_tables; i++) {
+		put_batch(r, pool, input_buffers[i], output_buffers[i]);
+		r->maintained += tables[i]->maintained;
+		dmm_buffer_unmap(tables[i]);
+		dmm_buffer_free(tables[i]);
+	}
+
+	if (pool) {
+		r->pool_hits = pool->hits;
+		r->pool_misses = pool->misses;
+		dmm_buffer_pool_free(pool);
+	}
+
+	return ok;
+}
+
+static inline bool
+issue_pair(struct task *t,
+		void **streams,
+		unsigned char *in,
+		unsigned char *out,
+		unsigned long size,
+		unsigned int slot)
+{
+#ifdef FILL_DATA
+	memset(in, t->fill++, size);
+#endif
+	/* shared memory is not cached; no maintenance needed */
+	return dsp_stream_issue(t->dsp_handle, streams[1], out, 0, input_buffer_size, slot) &&
+		dsp_stream_issue(t->dsp_handle, streams[0], in, size, input_buffer_size, slot);
+}
+
+/*
+ * Same copy as run_messages(), but the buffers go through a pair of
+ * zero-copy streams; only one message starts the loop, and an empty buffer
+ * stops it.
+ */
+static bool
+run_streams(struct task *t,
+		struct result *r)
+{
+	void *streams[2] = { NULL, NULL };
+	unsigned char *in_bufs[DUMMY_MAX_SLOTS], *out_bufs[DUMMY_MAX_SLOTS];
+	unsigned int i, slots, in_flight = 0;
+	unsigned long sent = 0, times = t->times;
+	uint64_t submitted[DUMMY_MAX_SLOTS];
+	struct dsp_msg msg;
+	bool ok = false, bad_reply = false;
+	struct dsp_stream_attr_in attrin = {
+		.cb = sizeof(attrin),
+		.timeout = -1,
+		.segment = 1,
+		.mode = STRMMODE_ZEROCOPY,
+	};
+
+	slots = r->slots = get_slots(t);
+	/* one more for the end of stream */
+	attrin.num_bufs = slots + 1;
 
-	if (!dsp_register(dsp_handle, &dummy_uuid, DSP_DCD_LIBRARYTYPE, "/lib/dsp/dummy.dll64P"))
-		return false;
+	if (!dsp_stream_open(t->dsp_handle, t->node, DSP_TONODE, 0, &attrin, &streams[0]) ||
+			!dsp_stream_open(t->dsp_handle, t->node, DSP_FROMNODE, 0, &attrin, &streams[1])) {
+		pr_err("dsp stream open failed");
+		goto leave;
+	}
 
-	if (!dsp_register(dsp_handle, &dummy_uuid, DSP_DCD_NODETYPE, "/lib/dsp/dummy.dll64P"))
-		return false;
+	if (!dsp_stream_allocate_buffers(t->dsp_handle, streams[0], input_buffer_size, in_bufs, slots) ||
+			!dsp_stream_allocate_buffers(t->dsp_handle, streams[1], input_buffer_size, out_bufs, slots)) {
+		pr_err("dsp stream allocate buffers failed");
+		goto leave;
+	}
+
+	msg.cmd = DUMMY_CMD_STREAM;
+	msg.arg_1 = msg.arg_2 = 0;
+	if (!dsp_node_put_message(t->dsp_handle, t->node, &msg, -1)) {
+		pr_err("dsp node put message failed");
+		goto leave;
+	}
+
+	pr_info("streaming %lu times, %u in flight", times, slots);
+
+	start_clock(t, r);
+
+	for (i = 0; i < slots && (times == 0 || sent < times); i++) {
+		submitted[i] = now();
+		if (!issue_pair(t, streams, in_bufs[i], out_bufs[i], input_buffer_size, i))
+			goto leave;
+		sent++;
+		in_flight++;
+	}
+
+	while (in_flight) {
+		unsigned char *in, *out;
+		unsigned long size, in_size, buf_size, slot, arg;
 
-	if (!dsp_node_allocate(dsp_handle, proc, &dummy_uuid, NULL, NULL, &node)) {
-		pr_err("dsp node allocate failed");
-		return NULL;
+		if (!dsp_stream_reclaim(t->dsp_handle, streams[1], &out, &size, &buf_size, &slot) ||
+				!dsp_stream_reclaim(t->dsp_handle, streams[0], &in, &in_size, &buf_size, &arg)) {
+			pr_err("dsp stream reclaim failed");
+			goto leave;
+		}
+		in_flight--;
+		r->completed++;
+
+		if (slot >= slots) {
+			/* the rest still has to come back */
+			pr_err("bad slot: %lu", slot);
+			bad_reply = true;
+			continue;
+		}
+
+		if (r->latency)
+			histogram_record(r->latency, now() - submitted[slot]);
+
+		if (!done && !bad_reply && (times == 0 || sent < times)) {
+			submitted[slot] = now();
+			if (!issue_pair(t, streams, in, out, input_buffer_size, slot))
+				goto leave;
+			sent++;
+			in_flight++;
+		}
 	}
 
-	if (!dsp_node_create(dsp_handle, node)) {
-		pr_err("dsp node create failed");
-		return NULL;
+	r->end = now();
+
+	/* end of stream */
+	if (issue_pair(t, streams, in_bufs[0], out_bufs[0], 0, 0)) {
+		unsigned char *buf;
+		unsigned long size, buf_size, arg;
+
+		dsp_stream_reclaim(t->dsp_handle, streams[1], &buf, &size, &buf_size, &arg);
+		dsp_stream_reclaim(t->dsp_handle, streams[0], &buf, &size, &buf_size, &arg);
 	}
 
-	pr_info("dsp node created");
+	get_message(t, &msg);
+	if (msg.arg_1 != r->completed)
+		pr_warning("node copied %u buffers, expected %lu", msg.arg_1, r->completed);
 
-	return node;
+	ok = !bad_reply;
+
+leave:
+	skip_clock(t, r);
+
+	for (i = 0; i < 2; i++) {
+		if (!streams[i])
+			continue;
+		dsp_stream_idle(t->dsp_handle, streams[i], true);
+		/* anything flushed has to be reclaimed before closing */
+		while (true) {
+			unsigned char *buf;
+			unsigned long size, buf_size, arg;
+			struct dsp_stream_info info;
+
+			if (!dsp_stream_get_info(t->dsp_handle, streams[i], &info, sizeof(info)) ||
+					!info.num_bufs_in_stream)
+				break;
+			if (!dsp_stream_reclaim(t->dsp_handle, streams[i], &buf, &size, &buf_size, &arg))
+				break;
+		}
+		dsp_stream_free_buffers(t->dsp_handle, streams[i], i ? out_bufs : in_bufs, slots);
+		dsp_stream_close(t->dsp_handle, streams[i]);
+	}
+
+	return ok;
 }
 
-static inline bool
-destroy_node(struct dsp_node *node)
+static bool
+run_task(struct task *t)
 {
-	if (node) {
-		if (!dsp_node_free(dsp_handle, node)) {
-			pr_err("dsp node free failed");
-			return false;
+	static const enum transport order[] = {
+		TRANSPORT_MESSAGE, TRANSPORT_LARGE_PAGES, TRANSPORT_IN_PLACE,
+		TRANSPORT_BATCH, TRANSPORT_STREAM,
+	};
+	unsigned int i;
+	bool ok = true;
+	struct dsp_msg msg = {
+		.cmd = DUMMY_CMD_KERNEL,
+		.arg_1 = DUMMY_KERNEL_COPY,
+	};
+
+	/* the node might come from a session that used another one */
+	if (kernel >= 0) {
+		msg.arg_1 = kernel;
+		msg.arg_2 = kernel_param;
+	}
+	dsp_node_put_message(t->dsp_handle, t->node, &msg, -1);
+
+	for (i = 0; i < NR_TRANSPORTS; i++) {
+		enum transport tr = order[i];
+		struct result *r = &t->result[tr];
+		size_t page_size = DMM_LARGE_PAGE_SIZE;
+
+		if (!(transports & (1 << tr)))
+			continue;
+
+		if (!ok) {
+			skip_clock(t, r);
+			continue;
 		}
 
-		pr_info("dsp node deleted");
+		switch (tr) {
+		case TRANSPORT_MESSAGE:
+			ok = run_messages(t, r, 0, false);
+			break;
+		case TRANSPORT_LARGE_PAGES:
+			if (input_buffer_size >= DMM_SECTION_SIZE)
+				page_size = DMM_SECTION_SIZE;
+			ok = run_messages(t, r, page_size, false);
+			break;
+		case TRANSPORT_IN_PLACE:
+			ok = run_messages(t, r, 0, true);
+			break;
+		case TRANSPORT_BATCH:
+			ok = run_batches(t, r);
+			break;
+		case TRANSPORT_STREAM:
+			ok = run_streams(t, r);
+			break;
+		default:
+			break;
+		}
 	}
 
-	return true;
+	return ok;
 }
 
-static inline void
-configure_dsp_node(void *node,
-		dmm_buffer_t *input_buffer,
-		dmm_buffer_t *output_buffer)
+static void *
+task_thread(void *data)
 {
-	struct dsp_msg msg;
+	struct task *t = data;
 
-	msg.cmd = 0;
-	msg.arg_1 = (uint32_t) input_buffer->map;
-	msg.arg_2 = (uint32_t) output_buffer->map;
-	dsp_node_put_message(dsp_handle, node, &msg, -1);
+	t->ok = run_task(t);
+	return NULL;
 }
 
 static bool
-run_task(struct dsp_node *node,
-		unsigned long times)
+run_session(struct task *tasks,
+		unsigned int count)
 {
-	unsigned long exit_status;
+	pthread_barrier_t barrier;
+	unsigned int i;
+	bool ok = true;
 
-	dmm_buffer_t *input_buffer;
-	dmm_buffer_t *output_buffer;
+	if (count == 1)
+		return run_task(&tasks[0]);
 
-	if (!dsp_node_run(dsp_handle, node)) {
-		pr_err("dsp node run failed");
-		return false;
+	pthread_barrier_init(&barrier, NULL, count);
+
+	for (i = 0; i < count; i++) {
+		tasks[i].barrier = &barrier;
+		if (pthread_create(&tasks[i].thread, NULL, task_thread, &tasks[i])) {
+			/* the barrier would never open */
+			pr_err("failed to create thread");
+			exit(-1);
+		}
 	}
 
-	pr_info("dsp node running");
+	for (i = 0; i < count; i++) {
+		pthread_join(tasks[i].thread, NULL);
+		if (!tasks[i].ok)
+			ok = false;
+	}
 
-	input_buffer = dmm_buffer_new(dsp_handle, proc, DMA_TO_DEVICE);
-	output_buffer = dmm_buffer_new(dsp_handle, proc, DMA_FROM_DEVICE);
+	pthread_barrier_destroy(&barrier);
 
-	dmm_buffer_allocate(input_buffer, input_buffer_size);
-	dmm_buffer_allocate(output_buffer, output_buffer_size);
+	return ok;
+}
 
-	dmm_buffer_map(output_buffer);
-	dmm_buffer_map(input_buffer);
+static void
+print_result(const char *name,
+		const struct result *r)
+{
+	double elapsed = (r->end - r->start) / 1000000000.0;
 
-	configure_dsp_node(node, input_buffer, output_buffer);
+	if (json) {
+		printf("{ ");
+		if (name)
+			printf("\"name\": \"%s\", ", name);
+		printf("\"buffers\": %lu, \"size\": %lu, \"depth\": %u, \"seconds\": %.6f",
+				r->completed, null_cmd ? 0 : input_buffer_size, r->slots, elapsed);
+		printf(", \"cache_skipped\": %lu", r->skipped);
+		if (r->mapped)
+			printf(", \"mapped\": %zu, \"cache_maintained\": %lu",
+					r->mapped, r->maintained);
+		if (kernel >= 0 && !null_cmd && r->arm_ns) {
+			printf(", \"kernel\": \"%s\", \"arm_seconds\": %.6f",
+					kernel_names[kernel], r->arm_ns / 1000000000.0);
+			if (verify)
+				printf(", \"errors\": %lu", r->errors);
+		}
+		if (r->sm_size)
+			printf(", \"sm\": { \"size\": %zu, \"high_water\": %zu, \"fragmentation\": %u }",
+					r->sm_size, r->sm_high_water, r->sm_fragmentation);
+		if (r->pool_hits || r->pool_misses)
+			printf(", \"pool\": { \"hits\": %lu, \"misses\": %lu }",
+					r->pool_hits, r->pool_misses);
+		if (r->latency) {
+			printf(", \"latency_ns\": ");
+			histogram_print_json(r->latency, stdout);
+		}
+		printf(" }");
+		return;
+	}
 
-	pr_info("running %lu times", times);
+	if (name)
+		printf("%s: ", name);
+	printf("%lu buffers in %.3f s: %.1f us/buffer, %.1f MB/s\n",
+			r->completed, elapsed,
+			r->completed ? elapsed * 1000000.0 / r->completed : 0.0,
+			elapsed > 0 && !null_cmd ? r->completed * input_buffer_size / elapsed / 1000000.0 : 0.0);
+	if (r->skipped)
+		printf("%lu cache operations skipped\n", r->skipped);
+	if (r->mapped)
+		printf("%zu bytes mapped, %.0f bytes of cache maintenance per buffer\n",
+				r->mapped, r->completed ? (double) r->maintained / r->completed : 0.0);
+	if (kernel >= 0 && !null_cmd && r->arm_ns) {
+		double arm = r->arm_ns / 1000000000.0;
 
-	while (!done) {
-		struct dsp_msg msg;
+		printf("%s on the arm: %.1f us/buffer, %.1f MB/s; dsp speedup %.2fx\n",
+				kernel_names[kernel],
+				r->completed ? arm * 1000000.0 / r->completed : 0.0,
+				arm > 0 ? r->completed * input_buffer_size / arm / 1000000.0 : 0.0,
+				elapsed > 0 ? arm / elapsed : 0.0);
+	}
+	if (verify && kernel >= 0 && !null_cmd && r->arm_ns)
+		printf("%lu buffers didn't match the reference\n", r->errors);
+	if (r->sm_size)
+		printf("shared memory: %zu of %zu bytes at peak, %u%% fragmented\n",
+				r->sm_high_water, r->sm_size, r->sm_fragmentation);
+	if (r->pool_hits || r->pool_misses)
+		printf("buffer pool: %lu hits, %lu misses\n", r->pool_hits, r->pool_misses);
+	if (r->latency) {
+		printf("round trip latency:\n");
+		histogram_print(r->latency, stdout, "ns");
+	}
+}
 
-#ifdef FILL_DATA
-		{
-			static unsigned char foo = 1;
-			unsigned int i;
-			for (i = 0; i < input_buffer->size; i++)
-				((char *) input_buffer->data)[i] = foo;
-			foo++;
-		}
-#endif
-		dmm_buffer_begin(input_buffer, input_buffer->size);
-		dmm_buffer_begin(output_buffer, output_buffer->size);
-		msg.cmd = 1;
-		msg.arg_1 = input_buffer->size;
-		dsp_node_put_message(dsp_handle, node, &msg, -1);
-		dsp_node_get_message(dsp_handle, node, &msg, -1);
-		dmm_buffer_end(input_buffer, input_buffer->size);
-		dmm_buffer_end(output_buffer, output_buffer->size);
-
-		if (--times == 0)
-			break;
+static void
+report_transport(struct task *tasks,
+		unsigned int count,
+		enum transport tr)
+{
+	struct result total;
+	unsigned int i;
+	char name[16];
+
+	if (count == 1) {
+		print_result(NULL, &tasks[0].result[tr]);
+		return;
 	}
 
-	dmm_buffer_unmap(output_buffer);
-	dmm_buffer_unmap(input_buffer);
+	memset(&total, 0, sizeof(total));
+	total.slots = tasks[0].result[tr].slots;
+	total.start = UINT64_MAX;
 
-	dmm_buffer_free(output_buffer);
-	dmm_buffer_free(input_buffer);
+	if (bench) {
+		total.latency = malloc(sizeof(*total.latency));
+		histogram_init(total.latency);
+	}
 
-	if (!dsp_node_terminate(dsp_handle, node, &exit_status)) {
-		pr_err("dsp node terminate failed: %lx", exit_status);
-		return false;
+	if (json)
+		printf("{ \"nodes\": [ ");
+
+	for (i = 0; i < count; i++) {
+		struct result *r = &tasks[i].result[tr];
+
+		snprintf(name, sizeof(name), "node %u", tasks[i].id);
+		if (json && i)
+			printf(", ");
+		print_result(name, r);
+
+		total.completed += r->completed;
+		total.skipped += r->skipped;
+		total.errors += r->errors;
+		total.mapped += r->mapped;
+		total.maintained += r->maintained;
+		total.pool_hits += r->pool_hits;
+		total.pool_misses += r->pool_misses;
+		/* the nodes ran the arm side in parallel too */
+		if (r->arm_ns > total.arm_ns)
+			total.arm_ns = r->arm_ns;
+		total.sm_size += r->sm_size;
+		total.sm_high_water += r->sm_high_water;
+		if (r->sm_fragmentation > total.sm_fragmentation)
+			total.sm_fragmentation = r->sm_fragmentation;
+		/* a node that failed early never started */
+		if (r->start && r->start < total.start)
+			total.start = r->start;
+		if (r->end > total.end)
+			total.end = r->end;
+		if (total.latency && r->latency)
+			histogram_merge(total.latency, r->latency);
 	}
 
-	pr_info("dsp node terminated");
+	if (total.start == UINT64_MAX)
+		total.start = total.end;
 
-	return true;
+	if (json)
+		printf(" ], \"total\": ");
+	print_result("total", &total);
+	if (json)
+		printf(" }");
+
+	free(total.latency);
+}
+
+static void
+report(struct task *tasks,
+		unsigned int count)
+{
+	unsigned int tr;
+	bool first = true;
+
+	/* a single transport keeps the plain format */
+	if (!(transports & (transports - 1))) {
+		for (tr = 0; !(transports & (1 << tr)); tr++);
+		report_transport(tasks, count, tr);
+		if (json)
+			printf("\n");
+		return;
+	}
+
+	if (json)
+		printf("{ ");
+
+	for (tr = 0; tr < NR_TRANSPORTS; tr++) {
+		if (!(transports & (1 << tr)))
+			continue;
+		if (json)
+			printf("%s\"%s\": ", first ? "" : ", ", transport_names[tr]);
+		else
+			printf("%s== %s ==\n", first ? "" : "\n", transport_names[tr]);
+		report_transport(tasks, count, tr);
+		first = false;
+	}
+
+	if (json)
+		printf(" }\n");
+}
+
+static void
+print_stats(void)
+{
+	struct dsp_ioctl_stats stats[64];
+	struct dsp_heap_stats heaps;
+	unsigned int i, j, n;
+
+	n = dsp_bridge_get_stats(stats, 64);
+	dsp_heap_pool_get_stats(&heaps);
+
+	if (json) {
+		printf("{ \"ioctls\": [ ");
+		for (i = 0; i < n; i++) {
+			struct dsp_ioctl_stats *s = &stats[i];
+
+			printf("%s{ \"name\": \"%s\", \"calls\": %llu, \"errors\": %llu",
+					i ? ", " : "", dsp_ioctl_name(s->request),
+					(unsigned long long) s->count, (unsigned long long) s->errors);
+			printf(", \"total_ns\": %llu, \"min_ns\": %llu, \"max_ns\": %llu, \"log2_ns\": [",
+					(unsigned long long) s->total_ns,
+					(unsigned long long) s->min_ns, (unsigned long long) s->max_ns);
+			for (j = 0; j < DSP_STATS_BUCKETS; j++)
+				printf("%s%llu", j ? ", " : " ", (unsigned long long) s->histogram[j]);
+			printf(" ] }");
+		}
+		printf(" ]");
+		if (profile >= 0)
+			printf(", \"heaps\": { \"allocated\": %lu, \"reused\": %lu, \"released\": %lu, \"pooled\": %u, \"pooled_bytes\": %zu }",
+					heaps.allocated, heaps.reused, heaps.released,
+					heaps.pooled, heaps.pooled_bytes);
+		if (user_buffers)
+			printf(", \"map_cache\": { \"hits\": %lu, \"misses\": %lu, \"evictions\": %lu }",
+					map_stats.hits, map_stats.misses, map_stats.evictions);
+		printf(" }\n");
+		return;
+	}
+
+	printf("%-22s %10s %8s %10s %10s %10s\n",
+			"ioctl", "calls", "errors", "mean ns", "min ns", "max ns");
+	for (i = 0; i < n; i++) {
+		struct dsp_ioctl_stats *s = &stats[i];
+
+		printf("%-22s %10llu %8llu %10llu %10llu %10llu\n",
+				dsp_ioctl_name(s->request),
+				(unsigned long long) s->count, (unsigned long long) s->errors,
+				(unsigned long long) (s->total_ns / s->count),
+				(unsigned long long) s->min_ns, (unsigned long long) s->max_ns);
+	}
+
+	if (profile >= 0)
+		printf("heaps: %lu allocated, %lu reused, %lu released, %u pooled (%zu bytes)\n",
+				heaps.allocated, heaps.reused, heaps.released,
+				heaps.pooled, heaps.pooled_bytes);
+
+	if (user_buffers)
+		printf("map cache: %lu hits, %lu misses, %lu evictions\n",
+				map_stats.hits, map_stats.misses, map_stats.evictions);
 }
 
 static void handle_options(int *argc, const char ***argv)
@@ -168,7 +1454,7 @@ static void handle_options(int *argc, const char ***argv)
 
 #ifdef DEBUG
 		if (!strcmp(cmd, "-d") || !strcmp(cmd, "--debug"))
-			debug_level = 4;
+			pr_set_level(4);
 #endif
 
 		if (!strcmp(cmd, "-n") || !strcmp(cmd, "--ntimes")) {
@@ -181,6 +1467,168 @@ static void handle_options(int *argc, const char ***argv)
 			(*argc)--;
 		}
 
+		if (!strcmp(cmd, "-b") || !strcmp(cmd, "--bench"))
+			bench = true;
+
+		if (!strcmp(cmd, "--json"))
+			json = true;
+
+		if (!strcmp(cmd, "--null"))
+			null_cmd = true;
+
+		if (!strcmp(cmd, "--reactor"))
+			use_reactor = true;
+
+		if (!strcmp(cmd, "--stats"))
+			show_stats = true;
+
+		if (!strcmp(cmd, "--sm"))
+			use_sm = true;
+
+		if (!strcmp(cmd, "--stream"))
+			transports = 1 << TRANSPORT_STREAM;
+
+		if (!strcmp(cmd, "--compare"))
+			transports = (1 << TRANSPORT_MESSAGE) | (1 << TRANSPORT_STREAM);
+
+		if (!strcmp(cmd, "--large-pages"))
+			transports = 1 << TRANSPORT_LARGE_PAGES;
+
+		if (!strcmp(cmd, "--compare-pages"))
+			transports = (1 << TRANSPORT_MESSAGE) | (1 << TRANSPORT_LARGE_PAGES);
+
+		if (!strcmp(cmd, "--batch") || !strcmp(cmd, "--compare-batch")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			transports = 1 << TRANSPORT_BATCH;
+			if (!strcmp(cmd, "--compare-batch"))
+				transports |= 1 << TRANSPORT_MESSAGE;
+			batch = atoi((*argv)[1]);
+			if (batch == 0)
+				batch = 1;
+			if (batch > DUMMY_MAX_DESCS / 2) {
+				pr_warning("batch limited to %u", DUMMY_MAX_DESCS / 2);
+				batch = DUMMY_MAX_DESCS / 2;
+			}
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "--in-place"))
+			transports = 1 << TRANSPORT_IN_PLACE;
+
+		if (!strcmp(cmd, "--compare-in-place"))
+			transports = (1 << TRANSPORT_MESSAGE) | (1 << TRANSPORT_IN_PLACE);
+
+		if (!strcmp(cmd, "--verify"))
+			verify = true;
+
+		if (!strcmp(cmd, "--sessions")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			sessions = atoi((*argv)[1]);
+			if (sessions == 0)
+				sessions = 1;
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "--cold"))
+			cold = true;
+
+		if (!strcmp(cmd, "--pool"))
+			use_pool = true;
+
+		if (!strcmp(cmd, "--user-buffers")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			user_buffers = atoi((*argv)[1]);
+			if (user_buffers > MAX_USER_BUFFERS) {
+				pr_warning("user buffers limited to %u", MAX_USER_BUFFERS);
+				user_buffers = MAX_USER_BUFFERS;
+			}
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "--map-budget")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			map_budget = strtoul((*argv)[1], NULL, 0);
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "--profile")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			profile = atoi((*argv)[1]);
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "--kernel")) {
+			char name[16], *param;
+
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			/* name[:parameter] */
+			snprintf(name, sizeof(name), "%s", (*argv)[1]);
+			param = strchr(name, ':');
+			if (param)
+				*param++ = '\0';
+			kernel = kernel_find(name);
+			if (kernel < 0) {
+				pr_err("unknown kernel: %s", name);
+				exit(-1);
+			}
+			kernel_param = param ? strtoul(param, NULL, 0) : kernel_params[kernel];
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "-s") || !strcmp(cmd, "--size")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			input_buffer_size = output_buffer_size = strtoul((*argv)[1], NULL, 0);
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "-k") || !strcmp(cmd, "--nodes")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			nr_nodes = atoi((*argv)[1]);
+			(*argv)++;
+			(*argc)--;
+		}
+
+		if (!strcmp(cmd, "-p") || !strcmp(cmd, "--depth")) {
+			if (*argc < 2) {
+				pr_err("bad option");
+				exit(-1);
+			}
+			depth = atoi((*argv)[1]);
+			(*argv)++;
+			(*argc)--;
+		}
+
 		(*argv)++;
 		(*argc)--;
 	}
@@ -188,19 +1636,50 @@ static void handle_options(int *argc, const char ***argv)
 
 int main(int argc, const char *argv[])
 {
-	struct dsp_node *node;
+	struct task tasks[MAX_NODES];
+	struct dsp_node_pool *pool = NULL;
+	struct dsp_reactor *reactor = NULL;
+	struct dsp_node_attr_in attrs = { 0 };
+	struct dsp_msg reset = { .cmd = DUMMY_CMD_RESET };
+	int dsp_handle;
+	void *proc = NULL;
+	unsigned int i, j, s, count = 0, failed = 0;
+	uint64_t session_ns = 0;
 	int ret = 0;
 
 	signal(SIGINT, signal_handler);
 
 #ifdef DEBUG
-	debug_level = 3;
+	pr_set_level(3);
 #endif
 	ntimes = 1000;
 
 	argc--; argv++;
 	handle_options(&argc, &argv);
 
+	if (kernel >= 0) {
+		size_t need = kernel_output_size(kernel, input_buffer_size);
+
+		/* a CRC is written whole, even for tiny buffers */
+		if (output_buffer_size < need)
+			output_buffer_size = need;
+		if ((transports & (1 << TRANSPORT_IN_PLACE)) && input_buffer_size < need) {
+			pr_err("%s in place needs buffers of at least %zu bytes",
+					kernel_names[kernel], need);
+			return -1;
+		}
+	}
+
+	memset(tasks, 0, sizeof(tasks));
+	all_tasks = tasks;
+
+	if (nr_nodes == 0)
+		nr_nodes = 1;
+	if (nr_nodes > MAX_NODES) {
+		pr_warning("nodes limited to %u", MAX_NODES);
+		nr_nodes = MAX_NODES;
+	}
+
 	dsp_handle = dsp_open();
 
 	if (dsp_handle < 0) {
@@ -214,17 +1693,182 @@ int main(int argc, const char *argv[])
 		goto leave;
 	}
 
-	node = create_node();
-	if (!node) {
+	if (!register_node(dsp_handle, false)) {
+		pr_err("dsp node registration failed");
+		ret = -1;
+		goto leave;
+	}
+
+	if ((transports & (1 << TRANSPORT_STREAM)) &&
+			(!node_props.num_input_streams || !node_props.num_output_streams)) {
+		pr_warning("node has no streams, skipping them");
+		transports &= ~(1 << TRANSPORT_STREAM);
+		if (!transports)
+			transports = 1 << TRANSPORT_MESSAGE;
+	}
+
+	if (use_pool && !(transports & (1 << TRANSPORT_BATCH)))
+		pr_warning("the buffer pool is only used by batches");
+	if (user_buffers && !(transports & (1 << TRANSPORT_BATCH)))
+		pr_warning("user buffers are only used by batches");
+
+	/* they outlive the sessions, and so do their mappings */
+	for (i = 0; user_buffers && i < nr_nodes; i++) {
+		struct task *t = &tasks[i];
+
+		t->cache = dmm_map_cache_new(dsp_handle, proc, map_budget);
+		for (j = 0; j < user_buffers; j++) {
+			if (posix_memalign(&t->frames[j], 128, input_buffer_size)) {
+				pr_err("failed to allocate user buffers");
+				ret = -1;
+				goto leave;
+			}
+		}
+	}
+
+	if (profile >= (int) node_props.count_profiles || profile >= MAX_PROFILES) {
+		pr_err("node has no profile %d", profile);
+		ret = -1;
+		goto leave;
+	}
+	if (profile >= 0 && !node_props.node_profiles[profile].heap_size)
+		pr_warning("profile %d has no heap", profile);
+
+	/* with a profile the bridge allocates the node's heap */
+	attrs.cb = sizeof(attrs);
+	attrs.priority = node_props.prio;
+	attrs.timeout = node_props.timeout;
+	attrs.profile_id = profile;
+
+	pool = dsp_node_pool_new(dsp_handle, proc, &dummy_uuid,
+			profile >= 0 ? &attrs : NULL, &reset, connect_streams, NULL);
+	if (!pool) {
+		ret = -1;
+		goto leave;
+	}
+
+	/* one thread waits for the replies of all the nodes */
+	if (use_reactor) {
+		reactor = dsp_reactor_new(dsp_handle);
+		if (!reactor) {
+			pr_err("failed to set up reactor");
+			ret = -1;
+			goto leave;
+		}
+	}
+
+	/* started ahead, so the sessions don't wait for the DSP to load them */
+	if (!cold && !dsp_node_pool_fill(pool, nr_nodes) &&
+			(!register_again(dsp_handle) || !dsp_node_pool_fill(pool, nr_nodes))) {
 		pr_err("dsp node creation failed");
 		ret = -1;
 		goto leave;
 	}
 
-	run_task(node, ntimes);
-	destroy_node(node);
+	/* the rest would most likely fail the same way */
+	for (s = 0; s < sessions && !done && !failed; s++) {
+		uint64_t start = now();
+		bool ok = true;
+
+		for (count = 0; count < nr_nodes; count++) {
+			struct task *t = &tasks[count];
+			unsigned int tr;
+
+			t->id = count;
+			t->dsp_handle = dsp_handle;
+			t->proc = proc;
+			t->times = ntimes;
+			t->fill = 1;
+			t->reactor = reactor;
+			t->inbox_head = t->inbox_count = 0;
+			/* only the last session is reported */
+			for (tr = 0; tr < NR_TRANSPORTS; tr++)
+				free(t->result[tr].latency);
+			memset(t->result, 0, sizeof(t->result));
+
+			t->node = dsp_node_pool_lease(pool);
+			if (!t->node && register_again(dsp_handle))
+				t->node = dsp_node_pool_lease(pool);
+			if (!t->node) {
+				pr_err("dsp node creation failed");
+				ok = false;
+				break;
+			}
+			if (reactor && !dsp_reactor_add(reactor, t->node)) {
+				pr_err("failed to add node to reactor");
+				release_node(pool, t->node);
+				ok = false;
+				break;
+			}
+		}
+		session_ns += now() - start;
+
+		if (ok && !run_session(tasks, nr_nodes))
+			ok = false;
+
+		for (i = 0; i < count; i++) {
+			/* the pool waits for the reset reply itself */
+			if (reactor)
+				dsp_reactor_remove(reactor, tasks[i].node);
+			if (!release_node(pool, tasks[i].node))
+				ok = false;
+		}
+		count = 0;
+
+		if (!ok) {
+			pr_err("session %u failed", s);
+			failed++;
+			ret = -1;
+		}
+	}
+
+	report(tasks, nr_nodes);
+
+	if (sessions > 1) {
+		struct dsp_node_pool_stats stats;
+		double start_us = session_ns / 1000.0 / s;
+
+		dsp_node_pool_get_stats(pool, &stats);
+		if (json)
+			printf("{ \"sessions\": %u, \"failed\": %u, \"start_us\": %.1f, \"warm\": %lu, \"cold\": %lu, \"reset_failures\": %lu }\n",
+					s, failed, start_us, stats.warm, stats.cold, stats.failed);
+		else
+			printf("%u sessions, %u failed: %.1f us to start, %lu warm nodes, %lu cold, %lu failed to reset\n",
+					s, failed, start_us, stats.warm, stats.cold, stats.failed);
+	}
 
 leave:
+	if (reactor)
+		dsp_reactor_free(reactor);
+
+	for (i = 0; i < count; i++)
+		if (tasks[i].node)
+			release_node(pool, tasks[i].node);
+
+	for (i = 0; i < nr_nodes; i++) {
+		unsigned int tr;
+
+		for (tr = 0; tr < NR_TRANSPORTS; tr++)
+			free(tasks[i].result[tr].latency);
+	}
+
+	for (i = 0; i < nr_nodes; i++) {
+		struct task *t = &tasks[i];
+
+		if (!t->cache)
+			continue;
+		map_stats.hits += t->cache->hits;
+		map_stats.misses += t->cache->misses;
+		map_stats.evictions += t->cache->evictions;
+		/* unmaps everything, so the memory can go */
+		dmm_map_cache_free(t->cache);
+		for (j = 0; j < user_buffers; j++)
+			free(t->frames[j]);
+	}
+
+	if (pool)
+		dsp_node_pool_free(pool);
+
 	if (proc) {
 		if (!dsp_detach(dsp_handle, proc)) {
 			pr_err("dsp detach failed");
@@ -240,5 +1884,8 @@ leave:
 		}
 	}
 
+	if (show_stats)
+		print_stats();
+
 	return ret;
 }
@@ -1,6 +1,14 @@
-	.sect ".3DAC26D0_6D4B_11DD_AD8B_0800200C9A66"
+#!/bin/sh
+#
+# Generates dummy_bridge.s, the DCD registration of the dummy node; the
+# properties come from the NODE_* variables of the Makefile.
+
+uuid=3DAC26D0_6D4B_11DD_AD8B_0800200C9A66
+
+cat <<END
+	.sect ".$uuid"
 	.string "1024," ; cbstruct (NOT USED);
-	.string "3DAC26D0_6D4B_11DD_AD8B_0800200C9A66," ; uuid;
+	.string "$uuid," ; uuid;
 	.string "dummy," ; name;
 	.string "1," ; type;
 
@@ -14,15 +22,15 @@
 	.string "1000," ; (NOT USED);
 	.string "100," ; (NOT USED);
 	.string "10," ; (NOT USED);
-	.string "1," ; priority;
-	.string "1024," ; stack size;
+	.string "${NODE_PRIORITY:-1}," ; priority;
+	.string "${NODE_STACK_SIZE:-1024}," ; stack size;
 	.string "16," ; system stack size (arbitrary)
 
 	.string "0," ; stack segment;
-	.string "3," ; max message depth queued to node;
-	.string "1," ; # of input streams;
-	.string "1," ; # of output streams;
-	.string "3e8H," ; timeout value of GPP blocking calls;
+	.string "${NODE_MESSAGE_DEPTH:-3}," ; max message depth queued to node;
+	.string "${NODE_INPUT_STREAMS:-1}," ; # of input streams;
+	.string "${NODE_OUTPUT_STREAMS:-1}," ; # of output streams;
+	.string "$(printf '%x' ${NODE_TIMEOUT:-1000})H," ; timeout value of GPP blocking calls;
 
 	.string "dummy_create," ; create phase name;
 	.string "dummy_execute," ; execute phase name;
@@ -37,23 +45,20 @@
 	.string "ff3f3f3fH," ; dynamic load data mem seg mask;
 	.string "ff3f3f3fH," ; dynamic load code mem seg mask;
 	.string "16," ; max # of node profiles supported;
-	.string "0," ; node profile 0;
-	.string "0," ; node profile 1;
-	.string "0," ; node profile 2;
-	.string "0," ; node profile 3;
-	.string "0," ; node profile 4;
-	.string "0," ; node profile 5;
-	.string "0," ; node profile 6;
-	.string "0," ; node profile 7;
-	.string "0," ; node profile 8;
-	.string "0," ; node profile 9;
-	.string "0," ; node profile 10;
-	.string "0," ; node profile 11;
-	.string "0," ; node profile 12;
-	.string "0," ; node profile 13;
-	.string "0," ; node profile 14;
-	.string "0," ; node profile 15;
+END
+
+# heap size of each profile; the ones not given are 0
+set -- $NODE_PROFILES
+i=0
+while [ $i -lt 16 ]; do
+	printf '\t.string "%s," ; node profile %d;\n' "${1:-0}" $i
+	[ $# -gt 0 ] && shift
+	i=$((i + 1))
+done
+
+cat <<END
 	.string "none," ; stackSegName segment;
 
 	.sect ".dcd_register";
-	.string "3DAC26D0_6D4B_11DD_AD8B_0800200C9A66:0,";
+	.string "$uuid:0,";
+END
@@ -21,44 +21,254 @@
 
 #include <stddef.h>
 #include "node.h"
+#include "dummy.h"
+#include "copy.h"
+#include "kernels.h"
+
+struct dummy_context {
+	void *env;
+	SIO_Handle in;
+	SIO_Handle out;
+};
+
+/* the code is shared by every instance of the node */
+static struct dummy_context contexts[DUMMY_MAX_NODES];
+
+static struct dummy_context *
+get_context(void *env)
+{
+	unsigned int i;
+
+	for (i = 0; i < DUMMY_MAX_NODES; i++)
+		if (contexts[i].env == env)
+			return &contexts[i];
+
+	return NULL;
+}
+
+static SIO_Handle
+open_stream(RMS_WORD def_word,
+		int mode)
+{
+	RMS_StrmDef *def = (RMS_StrmDef *) def_word;
+	SIO_Attrs attrs = SIO_ATTRS;
+
+	attrs.nbufs = def->nbufs;
+	attrs.segid = def->segid;
+	attrs.align = def->align;
+	attrs.timeout = def->timeout;
+	/* the buffers come from the GPP */
+	attrs.model = SIO_ISSUERECLAIM;
+
+	return SIO_create(def->name, mode, def->bufsize, &attrs);
+}
 
 unsigned int
-dummy_create(void)
+dummy_create(int arg_length,
+		char *arg_data,
+		int num_in_streams,
+		RMS_WORD in_stream_def[],
+		int num_out_streams,
+		RMS_WORD out_stream_def[],
+		void *env)
 {
+	struct dummy_context *ctx;
+
+	ctx = get_context(NULL);
+	if (!ctx)
+		return 0x8000;
+
+	ctx->env = env;
+	ctx->in = NULL;
+	ctx->out = NULL;
+
+	/* streams are optional; only the messages are used otherwise */
+	if (num_in_streams > 0 && num_out_streams > 0) {
+		ctx->in = open_stream(in_stream_def[0], SIO_INPUT);
+		ctx->out = open_stream(out_stream_def[0], SIO_OUTPUT);
+	}
+
 	return 0x8000;
 }
 
 unsigned int
-dummy_delete(void)
+dummy_delete(void *env)
 {
+	struct dummy_context *ctx;
+
+	ctx = get_context(env);
+	if (!ctx)
+		return 0x8000;
+
+	if (ctx->in)
+		SIO_delete(ctx->in);
+	if (ctx->out)
+		SIO_delete(ctx->out);
+	ctx->env = NULL;
+
 	return 0x8000;
 }
 
+static unsigned int
+run_streams(struct dummy_context *ctx)
+{
+	unsigned int count = 0;
+
+	while (1) {
+		void *in, *out;
+		uintptr_t arg, tmp;
+		int size, out_size;
+
+		size = SIO_reclaim(ctx->in, &in, &arg);
+		if (size < 0)
+			break;
+
+		out_size = SIO_reclaim(ctx->out, &out, &tmp);
+		if (out_size < 0) {
+			SIO_issue(ctx->in, in, 0, 0);
+			break;
+		}
+
+		if (size > out_size)
+			size = out_size;
+
+		BCACHE_inv(in, size, 1);
+		copy_data(out, in, size);
+		BCACHE_wb(out, size, 1);
+
+		SIO_issue(ctx->out, out, size, arg);
+		SIO_issue(ctx->in, in, 0, 0);
+
+		/* end of stream, already passed on */
+		if (size == 0)
+			break;
+		count++;
+	}
+
+	return count;
+}
+
+static unsigned int
+run_batch(struct dummy_desc_table *table,
+		unsigned int kernel,
+		uint32_t param)
+{
+	struct dummy_desc *in = NULL;
+	unsigned int i, count, pairs = 0;
+
+	BCACHE_inv(table, sizeof(*table), 1);
+
+	count = table->count;
+	if (count > DUMMY_MAX_DESCS)
+		count = DUMMY_MAX_DESCS;
+
+	for (i = 0; i < count; i++) {
+		struct dummy_desc *d = &table->desc[i];
+		unsigned int size;
+		void *src, *dst;
+
+		if (!(d->flags & DUMMY_DESC_OUTPUT)) {
+			in = d;
+			continue;
+		}
+
+		/* an output with no input before it gets nothing */
+		if (!in) {
+			d->len = 0;
+			continue;
+		}
+
+		/* what doesn't fit in the output is left out; a CRC can't be cut */
+		size = in->len;
+		if (kernel_output_size(kernel, size) > d->len)
+			size = d->len;
+		if (kernel_output_size(kernel, size) > d->len) {
+			d->len = 0;
+			in = NULL;
+			continue;
+		}
+
+		src = DSP_ADDR(in->addr);
+		dst = DSP_ADDR(d->addr);
+
+		BCACHE_inv(src, size, 1);
+		d->len = kernel_run(kernel, dst, src, size, param);
+		BCACHE_wb(dst, d->len, 1);
+
+		in = NULL;
+		pairs++;
+	}
+
+	/* the output lengths */
+	BCACHE_wb(table, sizeof(*table), 1);
+
+	return pairs;
+}
+
 unsigned int
 dummy_execute(void *env)
 {
 	dsp_msg_t msg;
-	void *input;
-	void *output;
+	void *input[DUMMY_MAX_SLOTS];
+	void *output[DUMMY_MAX_SLOTS];
+	unsigned int nslots = 0;
+	unsigned int kernel = DUMMY_KERNEL_COPY;
+	uint32_t param = 0;
 	unsigned char done = 0;
 
 	while (!done) {
 		NODE_getMsg(env, &msg, (unsigned) -1);
 
 		switch (msg.cmd) {
-		case 0:
-			input = (void *) (msg.arg_1);
-			output = (void *) (msg.arg_2);
+		case DUMMY_CMD_SETUP:
+			if (nslots < DUMMY_MAX_SLOTS) {
+				input[nslots] = DSP_ADDR(msg.arg_1);
+				output[nslots] = DSP_ADDR(msg.arg_2);
+				nslots++;
+			}
 			break;
-		case 1:
+		case DUMMY_CMD_RUN:
 			{
-				unsigned int size;
+				unsigned int size, slot;
 
 				size = (unsigned int) (msg.arg_1);
+				slot = (unsigned int) (msg.arg_2);
+
+				if (slot < nslots) {
+					BCACHE_inv(input[slot], size, 1);
+					msg.arg_1 = kernel_run(kernel, output[slot], input[slot], size, param);
+					BCACHE_wb(output[slot], msg.arg_1, 1);
+				} else
+					msg.arg_1 = 0;
+
+				NODE_putMsg(env, NULL, &msg, 0);
+				break;
+			}
+		case DUMMY_CMD_NULL:
+			NODE_putMsg(env, NULL, &msg, 0);
+			break;
+		case DUMMY_CMD_KERNEL:
+			if (msg.arg_1 < DUMMY_NR_KERNELS) {
+				kernel = msg.arg_1;
+				param = msg.arg_2;
+			}
+			break;
+		case DUMMY_CMD_BATCH:
+			msg.arg_1 = run_batch(DSP_ADDR(msg.arg_1), kernel, param);
+			NODE_putMsg(env, NULL, &msg, 0);
+			break;
+		case DUMMY_CMD_RESET:
+			nslots = 0;
+			NODE_putMsg(env, NULL, &msg, 0);
+			break;
+		case DUMMY_CMD_STREAM:
+			{
+				struct dummy_context *ctx = get_context(env);
 
-				BCACHE_inv(input, size, 1);
-				memcpy(output, input, size);
-				BCACHE_wb(output, size, 1);
+				if (ctx && ctx->in && ctx->out)
+					msg.arg_1 = run_streams(ctx);
+				else
+					msg.arg_1 = 0;
 
 				NODE_putMsg(env, NULL, &msg, 0);
 				break;
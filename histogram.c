@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "histogram.h"
+
+#include <string.h> /* for memset */
+
+#define HALF_COUNT (HISTOGRAM_SUB_COUNT / 2)
+
+static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+static inline unsigned int
+bucket_index(uint64_t value)
+{
+	unsigned int shift;
+
+	if (value < HISTOGRAM_SUB_COUNT)
+		return value;
+
+	shift = 64 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+	return (shift * HALF_COUNT) + (value >> shift);
+}
+
+/* highest value that falls in the bucket */
+static inline uint64_t
+bucket_value(unsigned int index)
+{
+	unsigned int shift;
+
+	if (index < HISTOGRAM_SUB_COUNT)
+		return index;
+
+	shift = index / HALF_COUNT - 1;
+	return ((uint64_t) (index - shift * HALF_COUNT) << shift) + ((1ULL << shift) - 1);
+}
+
+void histogram_init(struct histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+void histogram_record(struct histogram *h,
+		uint64_t value)
+{
+	h->counts[bucket_index(value)]++;
+	h->total++;
+	h->sum += value;
+	if (value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+}
+
+void histogram_merge(struct histogram *h,
+		const struct histogram *other)
+{
+	unsigned int i;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+		h->counts[i] += other->counts[i];
+	h->total += other->total;
+	h->sum += other->sum;
+	if (other->min < h->min)
+		h->min = other->min;
+	if (other->max > h->max)
+		h->max = other->max;
+}
+
+uint64_t histogram_percentile(const struct histogram *h,
+		double percentile)
+{
+	uint64_t target, count = 0;
+	unsigned int i;
+
+	if (!h->total)
+		return 0;
+
+	target = (uint64_t) (percentile / 100.0 * h->total + 0.5);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		count += h->counts[i];
+		if (count >= target) {
+			uint64_t value = bucket_value(i);
+			return value < h->max ? value : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+void histogram_print(const struct histogram *h,
+		FILE *f,
+		const char *unit)
+{
+	unsigned int i;
+
+	if (!h->total) {
+		fprintf(f, "no samples\n");
+		return;
+	}
+
+	fprintf(f, "samples: %llu\n", (unsigned long long) h->total);
+	fprintf(f, "min: %llu %s\n", (unsigned long long) h->min, unit);
+	fprintf(f, "mean: %llu %s\n", (unsigned long long) (h->sum / h->total), unit);
+	for (i = 0; i < sizeof(percentiles) / sizeof(*percentiles); i++)
+		fprintf(f, "p%g: %llu %s\n", percentiles[i],
+				(unsigned long long) histogram_percentile(h, percentiles[i]),
+				unit);
+	fprintf(f, "max: %llu %s\n", (unsigned long long) h->max, unit);
+}
+
+void histogram_print_json(const struct histogram *h,
+		FILE *f)
+{
+	unsigned int i;
+
+	fprintf(f, "{ \"samples\": %llu", (unsigned long long) h->total);
+	if (h->total) {
+		fprintf(f, ", \"min\": %llu", (unsigned long long) h->min);
+		fprintf(f, ", \"mean\": %llu", (unsigned long long) (h->sum / h->total));
+		for (i = 0; i < sizeof(percentiles) / sizeof(*percentiles); i++)
+			fprintf(f, ", \"p%g\": %llu", percentiles[i],
+					(unsigned long long) histogram_percentile(h, percentiles[i]));
+		fprintf(f, ", \"max\": %llu", (unsigned long long) h->max);
+	}
+	fprintf(f, " }");
+}
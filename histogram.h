@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Log-linear histogram, HdrHistogram style: every power of two is split in
+ * HISTOGRAM_SUB_COUNT / 2 linear buckets, so values are kept with ~3%
+ * precision over the whole 64-bit range.
+ */
+
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_COUNT / 2)
+
+struct histogram {
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+};
+
+void histogram_init(struct histogram *h);
+
+void histogram_record(struct histogram *h,
+		uint64_t value);
+
+void histogram_merge(struct histogram *h,
+		const struct histogram *other);
+
+uint64_t histogram_percentile(const struct histogram *h,
+		double percentile);
+
+void histogram_print(const struct histogram *h,
+		FILE *f,
+		const char *unit);
+
+void histogram_print_json(const struct histogram *h,
+		FILE *f);
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#include "kernels.h"
+#include "copy.h"
+
+#include <string.h> /* for strcmp */
+
+#ifdef _TMS320C6400_PLUS
+#include <c6x.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KERNELS_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define KERNELS_SSE2
+#endif
+
+/* in DUMMY_KERNEL_* order */
+const char *kernel_names[DUMMY_NR_KERNELS] = {
+	"copy",
+	"crc32",
+	"xor",
+	"swap16",
+	"swap32",
+	"gain",
+};
+
+const uint32_t kernel_params[DUMMY_NR_KERNELS] = {
+	0,
+	0,
+	0x5aa5c33c,
+	0,
+	0,
+	0x180, /* 1.5 */
+};
+
+int
+kernel_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < DUMMY_NR_KERNELS; i++)
+		if (!strcmp(kernel_names[i], name))
+			return i;
+
+	return -1;
+}
+
+/* CRC-32 */
+
+static const uint32_t crc_table[256] = {
+	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
+	0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
+	0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+	0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
+	0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de,
+	0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+	0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,
+	0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
+	0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+	0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
+	0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940,
+	0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+	0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116,
+	0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
+	0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+	0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
+	0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a,
+	0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+	0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818,
+	0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
+	0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+	0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
+	0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c,
+	0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+	0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2,
+	0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
+	0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+	0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
+	0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086,
+	0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+	0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4,
+	0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
+	0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+	0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
+	0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8,
+	0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+	0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe,
+	0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
+	0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+	0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
+	0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252,
+	0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+	0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60,
+	0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
+	0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+	0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
+	0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04,
+	0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+	0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a,
+	0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
+	0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+	0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
+	0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e,
+	0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+	0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c,
+	0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
+	0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+	0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
+	0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0,
+	0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+	0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6,
+	0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
+	0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
+};
+
+static size_t
+crc32(void *dst,
+		const void *src,
+		size_t size)
+{
+	const unsigned char *s = src;
+	unsigned char *d = dst;
+	uint32_t crc = 0xffffffff;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		crc = crc_table[(crc ^ s[i]) & 0xff] ^ (crc >> 8);
+	crc = ~crc;
+
+	d[0] = crc;
+	d[1] = crc >> 8;
+	d[2] = crc >> 16;
+	d[3] = crc >> 24;
+
+	return 4;
+}
+
+/* XOR */
+
+static void
+xor_ref(void *dst,
+		const void *src,
+		size_t size,
+		uint32_t key)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		d[i] = s[i] ^ (key >> (8 * (i & 3)));
+}
+
+static void
+xor_fast(void *dst,
+		const void *src,
+		size_t size,
+		uint32_t key)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i = 0;
+
+	/* the key is laid out from the start of the buffer, little-endian */
+#if defined(KERNELS_NEON)
+	uint8x16_t k = vreinterpretq_u8_u32(vdupq_n_u32(key));
+
+	for (; i + 16 <= size; i += 16)
+		vst1q_u8(d + i, veorq_u8(vld1q_u8(s + i), k));
+#elif defined(KERNELS_SSE2)
+	__m128i k = _mm_set1_epi32(key);
+
+	for (; i + 16 <= size; i += 16)
+		_mm_storeu_si128((__m128i *) (d + i),
+				_mm_xor_si128(_mm_loadu_si128((const __m128i *) (s + i)), k));
+#elif defined(_TMS320C6400_PLUS)
+	double k = _itod(key, key);
+
+	for (; i + 8 <= size; i += 8) {
+		double v = _memd8_const(s + i);
+		_memd8(d + i) = _itod(_hi(v) ^ _hi(k), _lo(v) ^ _lo(k));
+	}
+#endif
+	xor_ref(d + i, s + i, size - i, key);
+}
+
+/* byte swaps */
+
+static void
+swap16_ref(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i;
+
+	for (i = 0; i + 2 <= size; i += 2) {
+		unsigned char a = s[i];
+		d[i] = s[i + 1];
+		d[i + 1] = a;
+	}
+	if (i < size)
+		d[i] = s[i];
+}
+
+static void
+swap32_ref(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i;
+
+	for (i = 0; i + 4 <= size; i += 4) {
+		unsigned char a = s[i], b = s[i + 1];
+		d[i] = s[i + 3];
+		d[i + 1] = s[i + 2];
+		d[i + 2] = b;
+		d[i + 3] = a;
+	}
+	for (; i < size; i++)
+		d[i] = s[i];
+}
+
+#if defined(KERNELS_SSE2)
+static inline __m128i
+sse2_swap16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+static void
+swap16_fast(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i = 0;
+
+#if defined(KERNELS_NEON)
+	for (; i + 16 <= size; i += 16)
+		vst1q_u8(d + i, vrev16q_u8(vld1q_u8(s + i)));
+#elif defined(KERNELS_SSE2)
+	for (; i + 16 <= size; i += 16)
+		_mm_storeu_si128((__m128i *) (d + i),
+				sse2_swap16(_mm_loadu_si128((const __m128i *) (s + i))));
+#elif defined(_TMS320C6400_PLUS)
+	for (; i + 4 <= size; i += 4)
+		_mem4(d + i) = _swap4(_mem4_const(s + i));
+#endif
+	swap16_ref(d + i, s + i, size - i);
+}
+
+static void
+swap32_fast(void *dst,
+		const void *src,
+		size_t size)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	size_t i = 0;
+
+#if defined(KERNELS_NEON)
+	for (; i + 16 <= size; i += 16)
+		vst1q_u8(d + i, vrev32q_u8(vld1q_u8(s + i)));
+#elif defined(KERNELS_SSE2)
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = sse2_swap16(_mm_loadu_si128((const __m128i *) (s + i)));
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+		_mm_storeu_si128((__m128i *) (d + i), v);
+	}
+#elif defined(_TMS320C6400_PLUS)
+	for (; i + 4 <= size; i += 4)
+		_mem4(d + i) = _rotl(_swap4(_mem4_const(s + i)), 16);
+#endif
+	swap32_ref(d + i, s + i, size - i);
+}
+
+/* gain */
+
+static void
+gain_ref(void *dst,
+		const void *src,
+		size_t size,
+		int gain)
+{
+	int16_t *d = dst;
+	const int16_t *s = src;
+	size_t i, n = size / 2;
+
+	for (i = 0; i < n; i++) {
+		int32_t v = ((int32_t) s[i] * gain) >> 8;
+
+		if (v > INT16_MAX)
+			v = INT16_MAX;
+		else if (v < INT16_MIN)
+			v = INT16_MIN;
+		d[i] = v;
+	}
+	if (size & 1)
+		((unsigned char *) dst)[size - 1] = ((const unsigned char *) src)[size - 1];
+}
+
+static void
+gain_fast(void *dst,
+		const void *src,
+		size_t size,
+		int gain)
+{
+	int16_t *d = dst;
+	const int16_t *s = src;
+	size_t i = 0, n = size / 2;
+
+#if defined(KERNELS_NEON)
+	int16x4_t g = vdup_n_s16(gain);
+
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t v = vld1q_s16(s + i);
+		int32x4_t lo = vmull_s16(vget_low_s16(v), g);
+		int32x4_t hi = vmull_s16(vget_high_s16(v), g);
+		vst1q_s16(d + i, vcombine_s16(vqshrn_n_s32(lo, 8), vqshrn_n_s32(hi, 8)));
+	}
+#elif defined(KERNELS_SSE2)
+	__m128i g = _mm_set1_epi16(gain);
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+		__m128i l = _mm_mullo_epi16(v, g), h = _mm_mulhi_epi16(v, g);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(l, h), 8);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(l, h), 8);
+		_mm_storeu_si128((__m128i *) (d + i), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(_TMS320C6400_PLUS)
+	for (; i + 2 <= n; i += 2) {
+		unsigned int v = _mem4_const(s + i);
+		/* both halves; _spack2 saturates them back to 16 bits */
+		int lo = _mpy(v, gain) >> 8, hi = _mpyhl(v, gain) >> 8;
+		_mem4(d + i) = _spack2(hi, lo);
+	}
+#endif
+	gain_ref(d + i, s + i, size - 2 * i, gain);
+}
+
+static inline int
+gain_param(uint32_t param)
+{
+	/* has to fit in a 16-bit multiplier */
+	return param > INT16_MAX ? INT16_MAX : (int) param;
+}
+
+size_t
+kernel_output_size(unsigned int kernel,
+		size_t size)
+{
+	switch (kernel) {
+	case DUMMY_KERNEL_CRC32:
+		return 4;
+	case DUMMY_KERNEL_COPY:
+	case DUMMY_KERNEL_XOR:
+	case DUMMY_KERNEL_SWAP16:
+	case DUMMY_KERNEL_SWAP32:
+	case DUMMY_KERNEL_GAIN:
+		return size;
+	default:
+		return 0;
+	}
+}
+
+size_t
+kernel_run(unsigned int kernel,
+		void *dst,
+		const void *src,
+		size_t size,
+		uint32_t param)
+{
+	switch (kernel) {
+	case DUMMY_KERNEL_COPY:
+		if (dst != src)
+			copy_data(dst, src, size);
+		return size;
+	case DUMMY_KERNEL_CRC32:
+		return crc32(dst, src, size);
+	case DUMMY_KERNEL_XOR:
+		xor_fast(dst, src, size, param);
+		return size;
+	case DUMMY_KERNEL_SWAP16:
+		swap16_fast(dst, src, size);
+		return size;
+	case DUMMY_KERNEL_SWAP32:
+		swap32_fast(dst, src, size);
+		return size;
+	case DUMMY_KERNEL_GAIN:
+		gain_fast(dst, src, size, gain_param(param));
+		return size;
+	default:
+		return 0;
+	}
+}
+
+size_t
+kernel_run_ref(unsigned int kernel,
+		void *dst,
+		const void *src,
+		size_t size,
+		uint32_t param)
+{
+	switch (kernel) {
+	case DUMMY_KERNEL_COPY:
+		if (dst != src)
+			copy_ref(dst, src, size);
+		return size;
+	case DUMMY_KERNEL_CRC32:
+		return crc32(dst, src, size);
+	case DUMMY_KERNEL_XOR:
+		xor_ref(dst, src, size, param);
+		return size;
+	case DUMMY_KERNEL_SWAP16:
+		swap16_ref(dst, src, size);
+		return size;
+	case DUMMY_KERNEL_SWAP32:
+		swap32_ref(dst, src, size);
+		return size;
+	case DUMMY_KERNEL_GAIN:
+		gain_ref(dst, src, size, gain_param(param));
+		return size;
+	default:
+		return 0;
+	}
+}
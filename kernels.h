@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * Author: agent <agent@local>
+ *
+ * This file may be used under the terms of the GNU Lesser General Public
+ * License version 2.1, a copy of which is found in LICENSE included in the
+ * packaging of this file.
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dummy.h"
+
+/*
+ * The processing kernels of the dummy node (DUMMY_KERNEL_*). They build for
+ * the DSP, where the C64x+ gets intrinsics, and for the ARM, where NEON or
+ * SSE2 is used if available. Bytes that don't fill a whole sample are
+ * copied as they are.
+ *
+ * dst can be the same as src, to work in place; otherwise they must not
+ * overlap.
+ */
+
+extern const char *kernel_names[DUMMY_NR_KERNELS];
+
+/* default parameter of each kernel */
+extern const uint32_t kernel_params[DUMMY_NR_KERNELS];
+
+/* by name; -1 if there's no such kernel */
+int kernel_find(const char *name);
+
+/* how much kernel_run() writes to dst for 'size' bytes of input */
+size_t kernel_output_size(unsigned int kernel,
+		size_t size);
+
+/* returns the number of bytes written to dst */
+size_t kernel_run(unsigned int kernel,
+		void *dst,
+		const void *src,
+		size_t size,
+		uint32_t param);
+
+/* the same in plain C; what the others are checked against */
+size_t kernel_run_ref(unsigned int kernel,
+		void *dst,
+		const void *src,
+		size_t size,
+		uint32_t param);
+
+#endif /* KERNELS_H */
@@ -14,6 +14,10 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #define SYSLOG
 
@@ -22,7 +26,88 @@
 #endif
 
 #ifdef DEBUG
+#include <fnmatch.h>
+#include <string.h>
+
 unsigned debug_level = 2;
+
+/* provided by the linker, as long as there's at least one callsite */
+extern struct pr_callsite __start_pr_callsites[] __attribute__((weak));
+extern struct pr_callsite __stop_pr_callsites[] __attribute__((weak));
+
+static bool
+callsite_match(const struct pr_callsite *c,
+		const char *pattern)
+{
+	char tmp[256];
+
+	if (!fnmatch(pattern, c->function, 0))
+		return true;
+	if (!fnmatch(pattern, c->file, 0))
+		return true;
+	snprintf(tmp, sizeof(tmp), "%s:%u", c->file, c->line);
+	return !fnmatch(pattern, tmp, 0);
+}
+
+unsigned int pr_debug_enable(const char *pattern,
+		bool enable)
+{
+	struct pr_callsite *c;
+	unsigned int count = 0;
+
+	for (c = __start_pr_callsites; c < __stop_pr_callsites; c++) {
+		if (!callsite_match(c, pattern))
+			continue;
+		__atomic_store_n(&c->enabled, enable, __ATOMIC_RELAXED);
+		count++;
+	}
+
+	return count;
+}
+
+static void
+apply_env(void)
+{
+	const char *env = getenv("DSP_DEBUG");
+	char *tmp, *pattern, *saveptr;
+
+	if (!env)
+		return;
+
+	tmp = strdup(env);
+	if (!tmp)
+		return;
+
+	for (pattern = strtok_r(tmp, ",", &saveptr); pattern;
+			pattern = strtok_r(NULL, ",", &saveptr)) {
+		if (pattern[0] == '-')
+			pr_debug_enable(pattern + 1, false);
+		else
+			pr_debug_enable(pattern, true);
+	}
+
+	free(tmp);
+}
+
+void pr_set_level(unsigned int level)
+{
+	struct pr_callsite *c;
+
+	debug_level = level;
+	for (c = __start_pr_callsites; c < __stop_pr_callsites; c++)
+		if (c->level <= level)
+			__atomic_store_n(&c->enabled, true, __ATOMIC_RELAXED);
+
+	/* explicit patterns take precedence */
+	apply_env();
+}
+
+__attribute__((constructor))
+static void
+pr_debug_init(void)
+{
+	apply_env();
+}
 #endif
 
 #ifdef SYSLOG
@@ -52,49 +137,282 @@ log_level_to_string(unsigned int level)
 	}
 }
 
-void pr_helper(unsigned int level,
-		const char *file,
-		const char *function,
-		unsigned int line,
-		const char *fmt,
-		...)
-{
-	char *tmp;
-	va_list args;
+/*
+ * Errors and warnings are written right away, so the last ones before an
+ * abort or a crash aren't lost. Everything else is formatted at the call
+ * site into a fixed-size slot of a bounded lock-free ring (Vyukov's MPMC
+ * queue, used here with a single consumer), and written out by a background
+ * thread. Varargs can't be kept around, so a vsnprintf into the slot is the
+ * only work left on the caller; no memory is allocated and no lock is taken.
+ * When the ring is full the record is dropped and counted.
+ *
+ * The writer is only woken up when it's about to sleep, so a burst of
+ * records costs a single wakeup.
+ */
 
-#ifdef DEBUG
-	if (level > debug_level)
-		return;
-#endif
+#define LOG_RING_SIZE 256 /* power of two */
+#define LOG_MSG_SIZE 200
 
-	va_start(args, fmt);
+struct log_record {
+	unsigned long seq;
+	unsigned int level;
+	unsigned int line;
+	const char *file;
+	const char *function;
+	char msg[LOG_MSG_SIZE];
+};
 
-	if (vasprintf(&tmp, fmt, args) < 0)
-		goto leave;
+static struct log_record ring[LOG_RING_SIZE];
+static unsigned long enqueue_pos;
+static unsigned long dequeue_pos;
+static unsigned long written;
+static unsigned long dropped;
 
+static sem_t log_sem;
+static pthread_t log_thread;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static bool log_running;
+static bool log_quit;
+static bool log_sleeping;
+
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int flush_waiters;
+
+static void
+log_write(unsigned int level,
+		const char *file,
+		const char *function,
+		unsigned int line,
+		const char *msg)
+{
 	if (level <= 1) {
 #ifdef SYSLOG
-		syslog(log_level_to_syslog(level), "%s", tmp);
+		syslog(log_level_to_syslog(level), "%s", msg);
 #endif
 		fprintf(stderr, "%s: %s: %s\n",
-				log_level_to_string(level), function, tmp);
+				log_level_to_string(level), function, msg);
 	}
 	else if (level == 2)
 		fprintf(stderr, "%s: %s:%s(%u): %s\n",
-				log_level_to_string(level), file, function, line, tmp);
+				log_level_to_string(level), file, function, line, msg);
 #if defined(DEVEL) || defined(DEBUG)
 	else if (level == 3)
 		fprintf(stderr, "%s: %s: %s\n",
-				log_level_to_string(level), function, tmp);
+				log_level_to_string(level), function, msg);
 #endif
 #ifdef DEBUG
 	else if (level == 4)
 		fprintf(stderr, "%s: %s:%s(%u): %s\n",
-				log_level_to_string(level), file, function, line, tmp);
+				log_level_to_string(level), file, function, line, msg);
 #endif
+}
 
-	free(tmp);
+static void
+log_write_now(unsigned int level,
+		const char *function,
+		const char *fmt,
+		va_list args)
+{
+#ifdef SYSLOG
+	va_list copy;
 
-leave:
+	va_copy(copy, args);
+	vsyslog(log_level_to_syslog(level), fmt, copy);
+	va_end(copy);
+#endif
+	flockfile(stderr);
+	fprintf(stderr, "%s: %s: ", log_level_to_string(level), function);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	funlockfile(stderr);
+}
+
+static inline bool
+log_ready(void)
+{
+	struct log_record *r = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+
+	/* the slot is claimed but not yet filled, or the ring is empty */
+	return __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) == dequeue_pos + 1;
+}
+
+static bool
+log_pop(void)
+{
+	struct log_record *r = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+
+	if (!log_ready())
+		return false;
+
+	log_write(r->level, r->file, r->function, r->line, r->msg);
+
+	__atomic_store_n(&r->seq, dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+	dequeue_pos++;
+	__atomic_fetch_add(&written, 1, __ATOMIC_SEQ_CST);
+	return true;
+}
+
+/* only the first caller after the writer went to sleep has to post */
+static inline void
+log_wake(void)
+{
+	if (__atomic_exchange_n(&log_sleeping, false, __ATOMIC_SEQ_CST))
+		sem_post(&log_sem);
+}
+
+static void *
+log_loop(void *data)
+{
+	unsigned long reported = 0;
+
+	while (true) {
+		unsigned long lost;
+		bool quit;
+
+		quit = __atomic_load_n(&log_quit, __ATOMIC_ACQUIRE);
+
+		while (log_pop());
+
+		if (__atomic_load_n(&flush_waiters, __ATOMIC_SEQ_CST)) {
+			pthread_mutex_lock(&flush_lock);
+			pthread_cond_broadcast(&flush_cond);
+			pthread_mutex_unlock(&flush_lock);
+		}
+
+		lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+		if (lost != reported) {
+			fprintf(stderr, "%s: %s: %lu messages dropped\n",
+					log_level_to_string(1), __func__, lost - reported);
+			reported = lost;
+		}
+
+		if (quit)
+			break;
+
+		/* anything that came in before the flag was seen has to be picked up now */
+		__atomic_store_n(&log_sleeping, true, __ATOMIC_SEQ_CST);
+		if (log_ready() || __atomic_load_n(&log_quit, __ATOMIC_SEQ_CST) ||
+				__atomic_load_n(&dropped, __ATOMIC_RELAXED) != reported) {
+			__atomic_store_n(&log_sleeping, false, __ATOMIC_SEQ_CST);
+			continue;
+		}
+		while (sem_wait(&log_sem) && errno == EINTR);
+	}
+
+	return NULL;
+}
+
+static void
+log_exit(void)
+{
+	__atomic_store_n(&log_quit, true, __ATOMIC_SEQ_CST);
+	sem_post(&log_sem);
+	pthread_join(log_thread, NULL);
+	/* anything logged after this point is written synchronously */
+	__atomic_store_n(&log_running, false, __ATOMIC_RELEASE);
+}
+
+static void
+log_start(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < LOG_RING_SIZE; i++)
+		ring[i].seq = i;
+
+	if (sem_init(&log_sem, 0, 0))
+		return;
+	if (pthread_create(&log_thread, NULL, log_loop, NULL))
+		return;
+
+	atexit(log_exit);
+	__atomic_store_n(&log_running, true, __ATOMIC_RELEASE);
+}
+
+void pr_flush(void)
+{
+	unsigned long target;
+
+	if (!__atomic_load_n(&log_running, __ATOMIC_ACQUIRE))
+		return;
+
+	/* dropped records never got a position, so they aren't waited for */
+	target = __atomic_load_n(&enqueue_pos, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_lock(&flush_lock);
+	__atomic_fetch_add(&flush_waiters, 1, __ATOMIC_SEQ_CST);
+	log_wake();
+	while (__atomic_load_n(&written, __ATOMIC_SEQ_CST) < target)
+		pthread_cond_wait(&flush_cond, &flush_lock);
+	__atomic_fetch_sub(&flush_waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&flush_lock);
+}
+
+void pr_helper(unsigned int level,
+		const char *file,
+		const char *function,
+		unsigned int line,
+		const char *fmt,
+		...)
+{
+	struct log_record *r;
+	unsigned long pos;
+	va_list args;
+
+#ifdef DEBUG
+	/* pr_info() and pr_debug() are filtered at their callsite */
+	if (level < 3 && level > debug_level)
+		return;
+#endif
+
+	pthread_once(&log_once, log_start);
+
+	if (level <= 1) {
+		/* after whatever was logged before */
+		pr_flush();
+		va_start(args, fmt);
+		log_write_now(level, function, fmt, args);
+		va_end(args);
+		return;
+	}
+
+	if (!__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)) {
+		char msg[LOG_MSG_SIZE];
+
+		va_start(args, fmt);
+		vsnprintf(msg, sizeof(msg), fmt, args);
+		va_end(args);
+		log_write(level, file, function, line, msg);
+		return;
+	}
+
+	pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+	while (true) {
+		long diff;
+
+		r = &ring[pos & (LOG_RING_SIZE - 1)];
+		diff = (long) (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			log_wake();
+			return;
+		} else
+			pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+	}
+
+	r->level = level;
+	r->file = file;
+	r->function = function;
+	r->line = line;
+	va_start(args, fmt);
+	vsnprintf(r->msg, sizeof(r->msg), fmt, args);
 	va_end(args);
+
+	__atomic_store_n(&r->seq, pos + 1, __ATOMIC_SEQ_CST);
+	log_wake();
 }
@@ -13,7 +13,32 @@
 #define LOG_H
 
 #ifdef DEBUG
+#include <stdbool.h>
+
 extern unsigned debug_level;
+
+/*
+ * Every pr_info()/pr_debug() gets one of these in the pr_callsites section;
+ * a disabled statement costs a single test of 'enabled'.
+ */
+struct pr_callsite {
+	const char *file;
+	const char *function;
+	unsigned int line;
+	unsigned int level;
+	bool enabled;
+};
+
+/*
+ * Enables or disables the callsites whose file, function, or "file:line"
+ * match the fnmatch() pattern; returns how many matched. Patterns can also
+ * be given as a comma-separated list in DSP_DEBUG, '-' disables.
+ */
+unsigned int pr_debug_enable(const char *pattern,
+		bool enable);
+
+/* enables every callsite up to 'level' and sets debug_level */
+void pr_set_level(unsigned int level);
 #endif
 
 void pr_helper(unsigned int level,
@@ -23,6 +48,9 @@ void pr_helper(unsigned int level,
 		const char *fmt,
 		...) __attribute__((format(printf, 5, 6)));
 
+/* wait until everything logged so far has been written out */
+void pr_flush(void);
+
 #define pr_base(level, ...) pr_helper(level, __FILE__, __func__, __LINE__, __VA_ARGS__)
 
 #define pr_err(...) pr_base(0, __VA_ARGS__)
@@ -30,8 +58,15 @@ void pr_helper(unsigned int level,
 #define pr_test(...) pr_base(2, __VA_ARGS__)
 
 #ifdef DEBUG
-#define pr_info(...) pr_base(3, __VA_ARGS__)
-#define pr_debug(...) pr_base(4, __VA_ARGS__)
+#define pr_callsite(level, ...) ({ \
+	static struct pr_callsite __callsite \
+		__attribute__((section("pr_callsites"), used, aligned(sizeof(void *)))) = \
+		{ __FILE__, __func__, __LINE__, level, false }; \
+	if (__builtin_expect(__callsite.enabled, 0)) \
+		pr_base(level, __VA_ARGS__); })
+
+#define pr_info(...) pr_callsite(3, __VA_ARGS__)
+#define pr_debug(...) pr_callsite(4, __VA_ARGS__)
 #else
 #define pr_info(...) ({ if (0) pr_base(3, __VA_ARGS__); })
 #define pr_debug(...) ({ if (0) pr_base(4, __VA_ARGS__); })
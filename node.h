@@ -21,6 +21,7 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct {
@@ -32,7 +33,54 @@ typedef struct {
 extern unsigned short NODE_getMsg(void *node, dsp_msg_t *msg, unsigned int timeout);
 extern unsigned short NODE_putMsg(void *node, void *dest, dsp_msg_t *msg, unsigned int timeout);
 
+/* what the create phase gets for each stream connected to the node */
+typedef uintptr_t RMS_WORD;
+
+typedef struct {
+	RMS_WORD bufsize;
+	RMS_WORD nbufs;
+	RMS_WORD segid;
+	RMS_WORD align;
+	RMS_WORD timeout;
+	char name[1];
+} RMS_StrmDef;
+
+/* DSP/BIOS streams */
+typedef struct SIO_Obj *SIO_Handle;
+
+typedef struct {
+	int nbufs;
+	int segid;
+	int align;
+	unsigned short flush;
+	unsigned int model;
+	unsigned int timeout;
+	void *callback;
+} SIO_Attrs;
+
+#define SIO_INPUT 0
+#define SIO_OUTPUT 1
+
+#define SIO_STANDARD 0
+#define SIO_ISSUERECLAIM 1
+
+extern SIO_Attrs SIO_ATTRS;
+
+extern SIO_Handle SIO_create(char *name, int mode, unsigned int bufsize, SIO_Attrs *attrs);
+extern int SIO_delete(SIO_Handle stream);
+extern int SIO_issue(SIO_Handle stream, void *buf, unsigned int nbytes, uintptr_t arg);
+extern int SIO_reclaim(SIO_Handle stream, void **buf, uintptr_t *arg);
+
 extern void BCACHE_inv(void *ptr, size_t size, unsigned short wait);
+extern void BCACHE_wb(void *ptr, size_t size, unsigned short wait);
 extern void BCACHE_wbInv(void *ptr, size_t size, unsigned short wait);
 
+/* translate a DSP address received from the GPP into a pointer */
+#ifdef DSP_EMULATOR
+extern void *dsp_emu_addr(uint32_t addr);
+#define DSP_ADDR(addr) dsp_emu_addr(addr)
+#else
+#define DSP_ADDR(addr) ((void *) (addr))
+#endif
+
 #endif /* NODE_H */